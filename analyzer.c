@@ -0,0 +1,473 @@
+#include <stddef.h>
+#include <string.h>
+#include "item.h"
+#include "talloc.h"
+#include "gc.h"
+#include "linkedlist.h"
+#include "symbols.h"
+#include "interpreter.h"
+#include "compiler.h"
+#include "analyzer.h"
+
+typedef struct Node Node;
+
+// An analysed expression. Nodes are blocks of the unit of the lambda they were
+// analysed for, so the heap items they need are kept in its constants and
+// found by index; immediate items, interned symbols and global binding cells
+// never move, and are held directly.
+struct Node
+{
+    Item *(*run)(Node *node, Frame *frame);
+    Item *value;
+    Item **constants;
+    int constant;
+    int depth;
+    int index;
+    int count;
+    Node **children;
+};
+
+// The nodes of the unit being analysed, which are pointed at its constants
+// once it is finished
+static Node **unitNodes = NULL;
+static size_t unitNodeCount = 0;
+static size_t unitNodeCapacity = 0;
+
+static Node *analyze(Item *expression, bool tail);
+
+// Takes the function that evaluates a node and returns a new node using it
+static Node *newNode(Item *(*run)(Node *node, Frame *frame))
+{
+    Node *node = unitAlloc(sizeof(Node));
+    node->run = run;
+    node->value = NULL;
+    node->constants = NULL;
+    node->constant = -1;
+    node->depth = 0;
+    node->index = 0;
+    node->count = 0;
+    node->children = NULL;
+
+    if (unitNodeCount == unitNodeCapacity)
+    {
+        // the old list is simply left behind in the arena
+        size_t grown = unitNodeCapacity == 0 ? 256 : unitNodeCapacity * 2;
+        Node **copy = talloc(grown * sizeof(Node *));
+        if (unitNodeCount > 0)
+        {
+            memcpy(copy, unitNodes, unitNodeCount * sizeof(Node *));
+        }
+        unitNodes = copy;
+        unitNodeCapacity = grown;
+    }
+    unitNodes[unitNodeCount++] = node;
+    return node;
+}
+
+// Takes a node that refers to a constant and returns the constant
+static inline Item *constantOf(Node *node)
+{
+    return node->constants[node->constant];
+}
+
+// Takes a node and runs it in the given frame
+static inline Item *run(Node *node, Frame *frame)
+{
+    return node->run(node, frame);
+}
+
+// Returns an immediate item
+static Item *runImmediate(Node *node, Frame *frame)
+{
+    return node->value;
+}
+
+// Returns an item from the constant pool
+static Item *runConstant(Node *node, Frame *frame)
+{
+    return constantOf(node);
+}
+
+// Returns the value of a resolved local variable
+static Item *runLocal(Node *node, Frame *frame)
+{
+    for (int depth = node->depth; depth > 0; depth--)
+    {
+        frame = frame->parent;
+    }
+    Item *value = frame->slots[node->index];
+    if (value == NULL)
+    {
+        evaluationError("variable used before it was assigned");
+    }
+    return value;
+}
+
+// Returns the value of a global variable, looking its binding cell up the
+// first time
+static Item *runGlobal(Node *node, Frame *frame)
+{
+    if (node->value == NULL)
+    {
+        node->value = getGlobalCell(constantOf(node));
+    }
+    return cdr(node->value);
+}
+
+// Returns the value of a variable that has to be looked up by name
+static Item *runSymbol(Node *node, Frame *frame)
+{
+    return getsymbolfromframe(node->value, frame);
+}
+
+// Runs the test of an if, then one of its branches
+static Item *runIf(Node *node, Frame *frame)
+{
+    size_t roots = gcDepth();
+    gcPush(&frame);
+    Item *test = run(node->children[0], frame);
+    gcPop(roots);
+    return run(node->children[test == FALSE_ITEM ? 2 : 1], frame);
+}
+
+// Returns a closure over the frame
+static Item *runLambda(Node *node, Frame *frame)
+{
+    return makeLambda(constantOf(node), frame);
+}
+
+// Runs each expression of a body in turn and returns the value of the last
+static Item *runSequence(Node *node, Frame *frame)
+{
+    size_t roots = gcDepth();
+    gcPush(&frame);
+    for (int i = 0; i < node->count - 1; i++)
+    {
+        run(node->children[i], frame);
+    }
+    gcPop(roots);
+    return run(node->children[node->count - 1], frame);
+}
+
+// Evaluates the procedure of a call and returns it. The caller's frame
+// variable is rooted through the given pointer, since the caller goes on to
+// evaluate the arguments in it.
+static Item *evaluateProcedure(Node *node, Frame **frame)
+{
+    size_t roots = gcDepth();
+    gcPush(frame);
+    gcSafepoint();
+    Item *procedure = run(node->children[0], *frame);
+    gcPop(roots);
+    return procedure;
+}
+
+// Takes a primitive, evaluates each argument of the call onto the argument
+// stack in order, and returns the result of calling the primitive with them
+static Item *applyPrimitiveCall(Node *node, Frame *frame, Item *primitive)
+{
+    size_t base = argumentCount();
+    size_t roots = gcDepth();
+    gcPush(&frame);
+    gcPush(&primitive);
+    for (int i = 1; i < node->count; i++)
+    {
+        pushArgument(run(node->children[i], frame));
+    }
+    gcPop(roots);
+    return applyPrimitive(primitive, base);
+}
+
+// Takes the procedure of a call, evaluates each argument in order and returns
+// them as a list, built in order, each argument going on the end of it. The
+// procedure is rooted through the given pointer.
+static Item *evaluateArguments(Node *node, Frame *frame, Item **procedure)
+{
+    Item *args = makeNull();
+    Item *last = NULL;
+    size_t roots = gcDepth();
+    gcPush(&frame);
+    gcPush(procedure);
+    gcPush(&args);
+    gcPush(&last);
+    for (int i = 1; i < node->count; i++)
+    {
+        Item *arg = run(node->children[i], frame);
+        Item *pair = cons(arg, makeNull());
+        if (last == NULL)
+        {
+            args = pair;
+        }
+        else
+        {
+            last->c.cdr = pair;
+            gcWriteBarrier(last);
+        }
+        last = pair;
+    }
+    gcPop(roots);
+    return args;
+}
+
+// Makes a call that is not in tail position
+static Item *runCall(Node *node, Frame *frame)
+{
+    Item *procedure = evaluateProcedure(node, &frame);
+    if (typeOf(procedure) == PRIMITIVE_TYPE)
+    {
+        return applyPrimitiveCall(node, frame, procedure);
+    }
+    Item *args = evaluateArguments(node, frame, &procedure);
+    if (typeOf(procedure) == CLOSURE_TYPE)
+    {
+        return applyLambda(procedure, args);
+    }
+    if (typeOf(procedure) == CONTINUATION_TYPE)
+    {
+        return applyContinuation(procedure, args);
+    }
+    evaluationError("not a procedure");
+    return NULL;
+}
+
+// Makes a call in tail position, leaving a call to a closure to applyLambda
+static Item *runTailCall(Node *node, Frame *frame)
+{
+    Item *procedure = evaluateProcedure(node, &frame);
+    if (typeOf(procedure) == PRIMITIVE_TYPE)
+    {
+        return applyPrimitiveCall(node, frame, procedure);
+    }
+    Item *args = evaluateArguments(node, frame, &procedure);
+    if (typeOf(procedure) == CLOSURE_TYPE)
+    {
+        return tailCall(procedure, args);
+    }
+    if (typeOf(procedure) == CONTINUATION_TYPE)
+    {
+        return applyContinuation(procedure, args);
+    }
+    evaluationError("not a procedure");
+    return NULL;
+}
+
+// Takes a call to the primitive for an arithmetic operation with two
+// arguments, and makes it inline if both are integers. Returns NULL if the
+// global no longer holds the primitive, leaving the call to be made as usual.
+static Item *arithmeticCall(Node *node, Frame *frame)
+{
+    // the global is found without evaluating anything, and primitives never
+    // move, so the procedure needs no rooting
+    Item *procedure = run(node->children[0], frame);
+    if (!isArithmeticPrimitive(node->index, procedure))
+    {
+        return NULL;
+    }
+    Item *argv[2];
+    size_t roots = gcDepth();
+    gcPush(&frame);
+    argv[0] = run(node->children[1], frame);
+    gcPush(&argv[0]);
+    argv[1] = run(node->children[2], frame);
+    gcPop(roots);
+
+    Item *result;
+    if (fixnumArithmetic(node->index, argv[0], argv[1], &result))
+    {
+        return result;
+    }
+    return callPrimitive(procedure, 2, argv);
+}
+
+// Makes a call to an arithmetic primitive that is not in tail position
+static Item *runArithmetic(Node *node, Frame *frame)
+{
+    Item *result = arithmeticCall(node, frame);
+    return result != NULL ? result : runCall(node, frame);
+}
+
+// Makes a call to an arithmetic primitive in tail position
+static Item *runTailArithmetic(Node *node, Frame *frame)
+{
+    Item *result = arithmeticCall(node, frame);
+    return result != NULL ? result : runTailCall(node, frame);
+}
+
+// Hands an expression the analyser does not handle itself back to eval
+static Item *runEval(Node *node, Frame *frame)
+{
+    return eval(constantOf(node), frame);
+}
+
+// Hands an expression in tail position back to evalTail
+static Item *runEvalTail(Node *node, Frame *frame)
+{
+    return evalTail(constantOf(node), frame);
+}
+
+// Takes the function that evaluates a node and an item, and returns a new
+// node that finds the item in the constant pool
+static Node *constantNode(Item *(*run)(Node *node, Frame *frame), Item *item)
+{
+    Node *node = newNode(run);
+    node->constant = addConstant(item);
+    return node;
+}
+
+// Takes an item and returns a node that gives it back unevaluated
+static Node *quoteNode(Item *item)
+{
+    if (isImmediate(item))
+    {
+        Node *node = newNode(runImmediate);
+        node->value = item;
+        return node;
+    }
+    return constantNode(runConstant, item);
+}
+
+// Takes a list of expressions and returns a node for each, where the last
+// is in tail position if tail is set
+static Node **analyzeEach(Item *list, int count, bool tail)
+{
+    Node **nodes = unitAlloc(count * sizeof(Node *));
+    for (int i = 0; i < count; i++)
+    {
+        nodes[i] = analyze(car(list), tail && i == count - 1);
+        list = cdr(list);
+    }
+    return nodes;
+}
+
+// Takes a list whose head is a special form or a procedure, and whether it is
+// in tail position, and returns its node. Only well-formed ifs, lambdas and
+// quotes are analysed; eval checks and runs everything else, so errors come
+// out exactly as before.
+static Node *analyzeForm(Item *form, bool tail)
+{
+    Item *args = cdr(form);
+    Item *head = car(form);
+    switch (typeOf(head) == SYMBOL_TYPE ? formOf(head) : FORM_NONE)
+    {
+    case FORM_IF:
+    {
+        if (typeOf(args) != CONS_TYPE || typeOf(cdr(args)) != CONS_TYPE || typeOf(cdr(cdr(args))) != CONS_TYPE)
+        {
+            break;
+        }
+        Node *node = newNode(runIf);
+        node->count = 3;
+        node->children = unitAlloc(3 * sizeof(Node *));
+        node->children[0] = analyze(car(args), false);
+        node->children[1] = analyze(car(cdr(args)), tail);
+        node->children[2] = analyze(car(cdr(cdr(args))), tail);
+        return node;
+    }
+    case FORM_LAMBDA:
+    {
+        if (isNull(args))
+        {
+            break;
+        }
+        return constantNode(runLambda, args);
+    }
+    case FORM_QUOTE:
+    {
+        if (typeOf(args) != CONS_TYPE || !isNull(cdr(args)))
+        {
+            break;
+        }
+        return quoteNode(car(args));
+    }
+    case FORM_NONE:
+    {
+        itemType type = typeOf(head);
+        if (type != SYMBOL_TYPE && type != CONS_TYPE && type != LOCAL_TYPE && type != GLOBAL_TYPE)
+        {
+            break;
+        }
+        Node *node = newNode(tail ? runTailCall : runCall);
+        node->count = length(form);
+        node->children = analyzeEach(form, node->count, false);
+        if (type == GLOBAL_TYPE && node->count == 3)
+        {
+            // a call to + - * < > or = is made inline on integers; the
+            // operation is kept in index
+            arithmeticOp op = arithmeticOperation(head->gr.name);
+            if (op != ARITHMETIC_NONE)
+            {
+                node->run = tail ? runTailArithmetic : runArithmetic;
+                node->index = op;
+            }
+        }
+        return node;
+    }
+    default:
+        break;
+    }
+    return constantNode(tail ? runEvalTail : runEval, form);
+}
+
+// Takes an expression that has been through resolve(), and whether it is in
+// tail position, and returns its node
+static Node *analyze(Item *expression, bool tail)
+{
+    if (isImmediate(expression))
+    {
+        return quoteNode(expression);
+    }
+
+    switch (expression->type)
+    {
+    case LOCAL_TYPE:
+    {
+        Node *node = newNode(runLocal);
+        node->depth = expression->lr.depth;
+        node->index = expression->lr.index;
+        return node;
+    }
+    case GLOBAL_TYPE:
+        return constantNode(runGlobal, expression);
+    case SYMBOL_TYPE:
+    {
+        Node *node = newNode(runSymbol);
+        node->value = expression;
+        return node;
+    }
+    case CONS_TYPE:
+        return analyzeForm(expression, tail);
+    default:
+        return quoteNode(expression);
+    }
+}
+
+// Takes the parameter list of a lambda and its body, and returns a PTR_TYPE
+// item holding them analysed, as a unit of their own
+Item *analyzeLambda(Item *params, Item *body)
+{
+    Node *node = newNode(runSequence);
+    node->count = length(body);
+    node->children = analyzeEach(body, node->count, true);
+    node->constant = addConstant(params);
+
+    Item *lambda = finishUnit(node);
+    for (size_t i = 0; i < unitNodeCount; i++)
+    {
+        unitNodes[i]->constants = lambda->code.unit->slots;
+    }
+    unitNodeCount = 0;
+    return lambda;
+}
+
+// Takes an item returned by analyzeLambda and returns the parameter list
+Item *analyzedParams(Item *lambda)
+{
+    return constantOf(lambda->code.address);
+}
+
+// Takes an item returned by analyzeLambda and a frame and runs the body in it,
+// returning TAIL_CALL if it ends in a call to a closure
+Item *runAnalyzed(Item *lambda, Frame *frame)
+{
+    return run(lambda->code.address, frame);
+}
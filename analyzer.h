@@ -0,0 +1,25 @@
+#include "item.h"
+
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+// The body of every lambda is analysed once, the first time makeLambda sees
+// it, into a tree of nodes that each hold a pointer to the C function that
+// evaluates them. Running a node calls that function directly, instead of
+// going back through eval's type and special form dispatch. Constants,
+// variable references, if, lambda and procedure calls get nodes of their own;
+// every other special form is handed back to eval.
+
+// Takes the parameter list of a lambda, with any () left by an empty list
+// removed, and its body, and returns a PTR_TYPE item holding them analysed
+Item *analyzeLambda(Item *params, Item *body);
+
+// Takes an item returned by analyzeLambda and returns the parameter list
+Item *analyzedParams(Item *lambda);
+
+// Takes an item returned by analyzeLambda and a frame binding its parameters,
+// and returns the value of the body, or TAIL_CALL if the body ends in a call
+// to a closure that is still to be made
+Item *runAnalyzed(Item *lambda, Frame *frame);
+
+#endif
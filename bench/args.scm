@@ -0,0 +1,18 @@
+; Makes 300,000 calls that each pass five arguments, to a closure and to
+; primitives. Run it with --gc-stats and divide the objects allocated by the
+; number of calls to see what it costs to pass arguments.
+(define pick (lambda (a b c d e) c))
+
+(define loop
+  (lambda (n)
+    (if (= n 0)
+        0
+        (+ (pick n 2 3 4 5) (* 1 1 1 1 1) (loop (- n 1))))))
+
+(define run
+  (lambda (n)
+    (if (= n 0)
+        0
+        (+ (loop 1000) (run (- n 1))))))
+
+(run 100)
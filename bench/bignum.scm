@@ -0,0 +1,30 @@
+; Computes 5000! twice: once multiplying by 1, 2, 3 ... in turn, so nearly
+; every product is a bignum times a fixnum, and once by splitting the range in
+; halves, so the last products multiply two bignums of similar size, which is
+; where Karatsuba multiplication takes over. Then computes the 10,000th
+; Fibonacci number, which only adds, and prints it in full.
+(define factorial
+  (lambda (n acc)
+    (if (= n 0)
+        acc
+        (factorial (- n 1) (* acc n)))))
+
+(define product
+  (lambda (low high)
+    (if (= low high)
+        low
+        (multiply-halves low high (/ (- (+ low high) (modulo (+ low high) 2)) 2)))))
+
+(define multiply-halves
+  (lambda (low high middle)
+    (* (product low middle) (product (+ middle 1) high))))
+
+(define fib
+  (lambda (n a b)
+    (if (= n 0)
+        a
+        (fib (- n 1) b (+ a b)))))
+
+(= (factorial 5000 1) (product 1 5000))
+(modulo (product 1 5000) 1000000007)
+(fib 10000 0 1)
@@ -0,0 +1,17 @@
+; Makes 1,800,000 calls to procedures that do next to nothing, so the run time
+; is dominated by what it costs eval to dispatch a call.
+(define id (lambda (x) x))
+
+(define inner
+  (lambda (n)
+    (if (= n 0)
+        0
+        (inner (id (id (id (- n 1))))))))
+
+(define outer
+  (lambda (n)
+    (if (= n 0)
+        0
+        (+ (inner 1000) (outer (- n 1))))))
+
+(outer 300)
@@ -0,0 +1,27 @@
+; Knuth's man or boy test, run a thousand times over
+(define less-than-or-equal
+  (lambda (x y)
+    (if (> x y) #f #t)))
+
+(define a
+  (lambda (k x1 x2 x3 x4 x5)
+    (letrec ((b
+              (lambda ()
+                  (set! k (- k 1))
+                  (a k b x1 x2 x3 x4))))
+      (if (less-than-or-equal k 0)
+          (+ (x4) (x5))
+          (b)))))
+
+(define man-or-boy
+  (lambda ()
+    (a 10 (lambda () 1) (lambda () -1) (lambda () -1) (lambda () 1) (lambda () 0))))
+
+(define repeat
+  (lambda (n)
+    (if (= n 1)
+        (man-or-boy)
+        (let ((ignored (man-or-boy)))
+          (repeat (- n 1))))))
+
+(repeat 1000)
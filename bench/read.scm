@@ -0,0 +1,41 @@
+; Source text for the reader benchmark. It is cheap to run, so when it is
+; repeated many times over, as ./just bench_reader does, the time goes into
+; reading it; run that with --read-stats to see the throughput in MB/s.
+
+; A little of everything a program is made of: comments, nested lists,
+; symbols of all lengths, integers, doubles and strings
+(define accumulate
+  (lambda (combine initial sequence)
+    (if (null? sequence)
+        initial
+        (combine (car sequence)
+                 (accumulate combine initial (cdr sequence))))))
+
+(define enumerate-interval
+  (lambda (low high)
+    (if (> low high)
+        (quote ())
+        (cons low (enumerate-interval (+ low 1) high)))))
+
+(define sum-of-squares
+  (lambda (n)
+    (accumulate (lambda (x total) (+ (* x x) total))
+                0
+                (enumerate-interval 1 n))))
+
+(define table
+  (quote ((alpha 1 1.5 "first entry")
+          (beta 22 -2.25 "second entry")
+          (gamma 333 3.125 "third entry")
+          (delta 4444 -4.0625 "fourth entry")
+          (epsilon 55555 5.03125 "fifth entry")
+          (a-rather-long-symbol-name 123456789 0.000001 "a longer string with spaces in it"))))
+
+(define lookup
+  (lambda (key entries)
+    (if (null? entries)
+        #f
+        (let ((entry (car entries)))
+          (if (= key (car (cdr entry)))
+              entry
+              (lookup key (cdr entries)))))))
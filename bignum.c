@@ -0,0 +1,619 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "item.h"
+#include "talloc.h"
+#include "gc.h"
+#include "interpreter.h"
+#include "bignum.h"
+
+// Magnitudes are arrays of 32-bit digits, least significant first. The
+// arithmetic works on them in scratch memory from malloc, and only a result
+// that does not fit in an int is copied into the collected heap. Nothing here
+// reaches a safepoint, so the items taken as arguments never move.
+typedef uint32_t digit;
+typedef uint64_t twoDigits;
+#define DIGIT_BITS 32
+#define DIGIT_BASE ((twoDigits)1 << DIGIT_BITS)
+
+// Products where the shorter number has fewer digits than this are worked
+// out digit by digit. Above it Karatsuba's three half-size products save more
+// than their extra additions and copies cost.
+#define KARATSUBA_THRESHOLD 32
+
+// The most digits a bignum can have, since they are kept in one heap object
+#define BIGNUM_MAX_DIGITS 16000
+
+// The largest power of ten that fits in a digit, used to print and parse
+// nine decimal digits at a time
+#define DECIMAL_CHUNK 1000000000
+#define DECIMAL_CHUNK_DIGITS 9
+
+// An integer of either kind seen as a sign and a magnitude. A fixnum's single
+// digit is kept in the view itself.
+typedef struct Magnitude
+{
+    const digit *digits;
+    int length;
+    bool negative;
+    digit single;
+} Magnitude;
+
+// Takes a number of digits and returns uninitialized scratch memory for them
+static digit *scratch(size_t count)
+{
+    digit *memory = malloc((count > 0 ? count : 1) * sizeof(digit));
+    if (memory == NULL)
+    {
+        printf("Out of memory\n");
+        texit(1);
+    }
+    return memory;
+}
+
+// Takes a magnitude's digits and length and returns the length without any
+// leading zero digits
+static int trim(const digit *a, int length)
+{
+    while (length > 0 && a[length - 1] == 0)
+    {
+        length--;
+    }
+    return length;
+}
+
+// Takes an integer and fills in a view of its sign and magnitude
+static void magnitudeOf(Item *integer, Magnitude *view)
+{
+    if (typeOf(integer) == INT_TYPE)
+    {
+        int value = intValue(integer);
+        view->negative = value < 0;
+        view->single = value < 0 ? (digit)(-(int64_t)value) : (digit)value;
+        view->digits = &view->single;
+        view->length = value != 0;
+        return;
+    }
+    view->digits = integer->big.digits;
+    view->length = integer->big.length;
+    view->negative = integer->big.negative;
+}
+
+// Takes a magnitude and a sign and returns the integer, as a fixnum if it
+// fits in an int. Produces an evaluation error if it is too big to keep.
+static Item *makeInteger(const digit *magnitude, int length, bool negative)
+{
+    length = trim(magnitude, length);
+    if (length == 0)
+    {
+        return makeInt(0);
+    }
+    if (length == 1)
+    {
+        if (!negative && magnitude[0] <= INT_MAX)
+        {
+            return makeInt((int)magnitude[0]);
+        }
+        if (negative && magnitude[0] <= (digit)INT_MAX + 1)
+        {
+            return makeInt((int)-(int64_t)magnitude[0]);
+        }
+    }
+    if (length > BIGNUM_MAX_DIGITS)
+    {
+        evaluationError("Integer too large");
+    }
+
+    digit *digits = gcData(length * sizeof(digit));
+    memcpy(digits, magnitude, length * sizeof(digit));
+    Item *item = gcItem();
+    item->type = BIGNUM_TYPE;
+    item->big.digits = digits;
+    item->big.length = length;
+    item->big.negative = negative;
+    return item;
+}
+
+// Takes a 64-bit value and returns it as an integer
+static Item *makeIntegerFrom64(int64_t value)
+{
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    digit digits[2] = {(digit)magnitude, (digit)(magnitude >> DIGIT_BITS)};
+    return makeInteger(digits, 2, value < 0);
+}
+
+// Takes two magnitudes and returns a negative number, zero or a positive
+// number as the first is less than, equal to or greater than the second
+static int compareMagnitudes(const digit *a, int na, const digit *b, int nb)
+{
+    na = trim(a, na);
+    nb = trim(b, nb);
+    if (na != nb)
+    {
+        return na < nb ? -1 : 1;
+    }
+    for (int i = na - 1; i >= 0; i--)
+    {
+        if (a[i] != b[i])
+        {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// Takes two magnitudes and stores their sum in out, which has room for one
+// digit more than the longer of them. Returns the length of the sum.
+static int addMagnitudes(const digit *a, int na, const digit *b, int nb, digit *out)
+{
+    if (na < nb)
+    {
+        const digit *swap = a;
+        a = b;
+        b = swap;
+        int swapLength = na;
+        na = nb;
+        nb = swapLength;
+    }
+    twoDigits carry = 0;
+    for (int i = 0; i < na; i++)
+    {
+        carry += (twoDigits)a[i] + (i < nb ? b[i] : 0);
+        out[i] = (digit)carry;
+        carry >>= DIGIT_BITS;
+    }
+    out[na] = (digit)carry;
+    return na + 1;
+}
+
+// Takes two magnitudes, the first no smaller than the second, and stores
+// their difference in out, which has room for as many digits as the first.
+// Returns the length of the difference.
+static int subtractMagnitudes(const digit *a, int na, const digit *b, int nb, digit *out)
+{
+    twoDigits borrow = 0;
+    for (int i = 0; i < na; i++)
+    {
+        twoDigits difference = (twoDigits)a[i] - (i < nb ? b[i] : 0) - borrow;
+        out[i] = (digit)difference;
+        borrow = difference >> (2 * DIGIT_BITS - 1);
+    }
+    return na;
+}
+
+// Takes a magnitude out with room for length digits and adds x to it, shifted
+// up by offset digits. The sum has to fit.
+static void addInto(digit *out, int length, const digit *x, int nx, int offset)
+{
+    twoDigits carry = 0;
+    for (int i = 0; i < nx; i++)
+    {
+        carry += (twoDigits)out[offset + i] + x[i];
+        out[offset + i] = (digit)carry;
+        carry >>= DIGIT_BITS;
+    }
+    for (int i = offset + nx; carry != 0 && i < length; i++)
+    {
+        carry += out[i];
+        out[i] = (digit)carry;
+        carry >>= DIGIT_BITS;
+    }
+}
+
+// Takes a magnitude t and subtracts x from it in place. The difference must
+// not be negative.
+static void subtractFrom(digit *t, int nt, const digit *x, int nx)
+{
+    twoDigits borrow = 0;
+    for (int i = 0; i < nt && (i < nx || borrow != 0); i++)
+    {
+        twoDigits difference = (twoDigits)t[i] - (i < nx ? x[i] : 0) - borrow;
+        t[i] = (digit)difference;
+        borrow = difference >> (2 * DIGIT_BITS - 1);
+    }
+}
+
+// Takes two magnitudes and stores their product in out, which has room for
+// na + nb digits, one digit of one by one digit of the other
+static void multiplySchoolbook(const digit *a, int na, const digit *b, int nb, digit *out)
+{
+    memset(out, 0, (na + nb) * sizeof(digit));
+    for (int i = 0; i < na; i++)
+    {
+        if (a[i] == 0)
+        {
+            continue;
+        }
+        twoDigits carry = 0;
+        for (int j = 0; j < nb; j++)
+        {
+            carry += (twoDigits)a[i] * b[j] + out[i + j];
+            out[i + j] = (digit)carry;
+            carry >>= DIGIT_BITS;
+        }
+        out[i + nb] = (digit)carry;
+    }
+}
+
+// Takes two magnitudes and stores their product in out, which has room for
+// na + nb digits. Above KARATSUBA_THRESHOLD each half of the longer number
+// is multiplied by the matching half of the shorter, and the cross terms come
+// from one product of sums instead of two, so three products of half the size
+// do the work of four.
+static void multiplyMagnitudes(const digit *a, int na, const digit *b, int nb, digit *out)
+{
+    if (na < nb)
+    {
+        const digit *swap = a;
+        a = b;
+        b = swap;
+        int swapLength = na;
+        na = nb;
+        nb = swapLength;
+    }
+    if (nb < KARATSUBA_THRESHOLD)
+    {
+        multiplySchoolbook(a, na, b, nb, out);
+        return;
+    }
+
+    if (na >= 2 * nb)
+    {
+        // split the longer number into pieces the size of the shorter, so
+        // every product is balanced
+        memset(out, 0, (na + nb) * sizeof(digit));
+        digit *partial = scratch(2 * nb);
+        for (int start = 0; start < na; start += nb)
+        {
+            int piece = na - start < nb ? na - start : nb;
+            multiplyMagnitudes(a + start, piece, b, nb, partial);
+            addInto(out, na + nb, partial, piece + nb, start);
+        }
+        free(partial);
+        return;
+    }
+
+    // a = a1 B^half + a0 and b = b1 B^half + b0, where b1 is not empty since
+    // b is more than half as long as a
+    int half = na / 2;
+    int na1 = na - half;
+    int nb1 = nb - half;
+
+    // a0 b0 goes in the bottom of out and a1 b1 in the top
+    multiplyMagnitudes(a, half, b, half, out);
+    multiplyMagnitudes(a + half, na1, b + half, nb1, out + 2 * half);
+
+    // (a0 + a1)(b0 + b1) - a0 b0 - a1 b1 = a0 b1 + a1 b0
+    digit *sumA = scratch(na1 + 1);
+    digit *sumB = scratch((half > nb1 ? half : nb1) + 1);
+    int nsa = addMagnitudes(a, half, a + half, na1, sumA);
+    int nsb = addMagnitudes(b, half, b + half, nb1, sumB);
+    digit *middle = scratch(nsa + nsb);
+    multiplyMagnitudes(sumA, nsa, sumB, nsb, middle);
+    subtractFrom(middle, nsa + nsb, out, 2 * half);
+    subtractFrom(middle, nsa + nsb, out + 2 * half, na1 + nb1);
+    addInto(out, na + nb, middle, trim(middle, nsa + nsb), half);
+
+    free(sumA);
+    free(sumB);
+    free(middle);
+}
+
+// Takes a magnitude and a digit, divides the magnitude by the digit in place
+// and returns the remainder
+static digit divideByDigit(digit *a, int na, digit divisor)
+{
+    twoDigits remainder = 0;
+    for (int i = na - 1; i >= 0; i--)
+    {
+        twoDigits current = (remainder << DIGIT_BITS) | a[i];
+        a[i] = (digit)(current / divisor);
+        remainder = current % divisor;
+    }
+    return (digit)remainder;
+}
+
+// Takes a magnitude a and a magnitude b of at least two digits with no
+// leading zeros, where a is at least as long as b, and stores the quotient in
+// q, which has room for na - nb + 1 digits, and the remainder in r, which has
+// room for nb. This is Knuth's algorithm D: both are shifted so that b's top
+// digit has its top bit set, which makes the quotient digit guessed from the
+// top two digits at most two too big.
+static void divideMagnitudes(const digit *a, int na, const digit *b, int nb, digit *q, digit *r)
+{
+    int shift = __builtin_clz(b[nb - 1]);
+    digit *v = scratch(nb);
+    digit *u = scratch(na + 1);
+    for (int i = nb - 1; i > 0; i--)
+    {
+        v[i] = shift == 0 ? b[i] : (b[i] << shift) | (b[i - 1] >> (DIGIT_BITS - shift));
+    }
+    v[0] = b[0] << shift;
+    u[na] = shift == 0 ? 0 : a[na - 1] >> (DIGIT_BITS - shift);
+    for (int i = na - 1; i > 0; i--)
+    {
+        u[i] = shift == 0 ? a[i] : (a[i] << shift) | (a[i - 1] >> (DIGIT_BITS - shift));
+    }
+    u[0] = a[0] << shift;
+
+    for (int j = na - nb; j >= 0; j--)
+    {
+        // guess the quotient digit from the top digits, then correct it
+        twoDigits top = ((twoDigits)u[j + nb] << DIGIT_BITS) | u[j + nb - 1];
+        twoDigits guess = top / v[nb - 1];
+        twoDigits rest = top % v[nb - 1];
+        while (guess >= DIGIT_BASE || guess * v[nb - 2] > ((rest << DIGIT_BITS) | u[j + nb - 2]))
+        {
+            guess--;
+            rest += v[nb - 1];
+            if (rest >= DIGIT_BASE)
+            {
+                break;
+            }
+        }
+
+        // subtract guess times v from the top of u
+        int64_t borrow = 0;
+        int64_t difference;
+        for (int i = 0; i < nb; i++)
+        {
+            twoDigits product = guess * v[i];
+            difference = (int64_t)u[i + j] - borrow - (int64_t)(product & (DIGIT_BASE - 1));
+            u[i + j] = (digit)difference;
+            borrow = (int64_t)(product >> DIGIT_BITS) - (difference >> DIGIT_BITS);
+        }
+        difference = (int64_t)u[j + nb] - borrow;
+        u[j + nb] = (digit)difference;
+
+        q[j] = (digit)guess;
+        if (difference < 0)
+        {
+            // the guess was one too big, so add v back
+            q[j]--;
+            twoDigits carry = 0;
+            for (int i = 0; i < nb; i++)
+            {
+                carry += (twoDigits)u[i + j] + v[i];
+                u[i + j] = (digit)carry;
+                carry >>= DIGIT_BITS;
+            }
+            u[j + nb] += (digit)carry;
+        }
+    }
+
+    // the remainder is what is left of u, shifted back
+    for (int i = 0; i < nb; i++)
+    {
+        r[i] = shift == 0 ? u[i] : (u[i] >> shift) | (u[i + 1] << (DIGIT_BITS - shift));
+    }
+    free(v);
+    free(u);
+}
+
+// Takes two integers and returns a + b, or a - b if subtract is set
+static Item *addSigned(Item *a, Item *b, bool subtract)
+{
+    Magnitude x;
+    Magnitude y;
+    magnitudeOf(a, &x);
+    magnitudeOf(b, &y);
+    bool yNegative = y.negative != subtract;
+
+    int longer = x.length > y.length ? x.length : y.length;
+    digit *out = scratch(longer + 1);
+    Item *result;
+    if (x.negative == yNegative)
+    {
+        int length = addMagnitudes(x.digits, x.length, y.digits, y.length, out);
+        result = makeInteger(out, length, x.negative);
+    }
+    else if (compareMagnitudes(x.digits, x.length, y.digits, y.length) >= 0)
+    {
+        int length = subtractMagnitudes(x.digits, x.length, y.digits, y.length, out);
+        result = makeInteger(out, length, x.negative);
+    }
+    else
+    {
+        int length = subtractMagnitudes(y.digits, y.length, x.digits, x.length, out);
+        result = makeInteger(out, length, yNegative);
+    }
+    free(out);
+    return result;
+}
+
+// Takes two integers and returns their sum
+Item *integerAdd(Item *a, Item *b)
+{
+    if (typeOf(a) == INT_TYPE && typeOf(b) == INT_TYPE)
+    {
+        return makeIntegerFrom64((int64_t)intValue(a) + intValue(b));
+    }
+    return addSigned(a, b, false);
+}
+
+// Takes two integers and returns a - b
+Item *integerSubtract(Item *a, Item *b)
+{
+    if (typeOf(a) == INT_TYPE && typeOf(b) == INT_TYPE)
+    {
+        return makeIntegerFrom64((int64_t)intValue(a) - intValue(b));
+    }
+    return addSigned(a, b, true);
+}
+
+// Takes two integers and returns their product
+Item *integerMultiply(Item *a, Item *b)
+{
+    if (typeOf(a) == INT_TYPE && typeOf(b) == INT_TYPE)
+    {
+        return makeIntegerFrom64((int64_t)intValue(a) * intValue(b));
+    }
+    Magnitude x;
+    Magnitude y;
+    magnitudeOf(a, &x);
+    magnitudeOf(b, &y);
+    if (x.length == 0 || y.length == 0)
+    {
+        return makeInt(0);
+    }
+    digit *out = scratch(x.length + y.length);
+    multiplyMagnitudes(x.digits, x.length, y.digits, y.length, out);
+    Item *result = makeInteger(out, x.length + y.length, x.negative != y.negative);
+    free(out);
+    return result;
+}
+
+// Takes two integers and returns a / b rounded towards zero, storing the
+// remainder, which has the sign of a, through the given pointer
+Item *integerDivide(Item *a, Item *b, Item **remainder)
+{
+    if (b == makeInt(0))
+    {
+        evaluationError("Division by zero");
+    }
+    if (typeOf(a) == INT_TYPE && typeOf(b) == INT_TYPE)
+    {
+        int64_t x = intValue(a);
+        int64_t y = intValue(b);
+        *remainder = makeInt((int)(x % y));
+        return makeIntegerFrom64(x / y);
+    }
+
+    Magnitude x;
+    Magnitude y;
+    magnitudeOf(a, &x);
+    magnitudeOf(b, &y);
+    if (compareMagnitudes(x.digits, x.length, y.digits, y.length) < 0)
+    {
+        *remainder = a;
+        return makeInt(0);
+    }
+
+    bool negative = x.negative != y.negative;
+    Item *quotient;
+    if (y.length == 1)
+    {
+        digit *q = scratch(x.length);
+        memcpy(q, x.digits, x.length * sizeof(digit));
+        digit r = divideByDigit(q, x.length, y.digits[0]);
+        quotient = makeInteger(q, x.length, negative);
+        *remainder = makeInteger(&r, 1, x.negative);
+        free(q);
+        return quotient;
+    }
+
+    digit *q = scratch(x.length - y.length + 1);
+    digit *r = scratch(y.length);
+    divideMagnitudes(x.digits, x.length, y.digits, y.length, q, r);
+    quotient = makeInteger(q, x.length - y.length + 1, negative);
+    *remainder = makeInteger(r, y.length, x.negative);
+    free(q);
+    free(r);
+    return quotient;
+}
+
+// Takes two integers and returns a negative number, zero or a positive number
+// as a is less than, equal to or greater than b
+int integerCompare(Item *a, Item *b)
+{
+    if (typeOf(a) == INT_TYPE && typeOf(b) == INT_TYPE)
+    {
+        return (intValue(a) > intValue(b)) - (intValue(a) < intValue(b));
+    }
+    Magnitude x;
+    Magnitude y;
+    magnitudeOf(a, &x);
+    magnitudeOf(b, &y);
+    if (x.negative != y.negative)
+    {
+        return x.negative ? -1 : 1;
+    }
+    int order = compareMagnitudes(x.digits, x.length, y.digits, y.length);
+    return x.negative ? -order : order;
+}
+
+// Takes an integer and returns the nearest double
+double integerToDouble(Item *a)
+{
+    if (typeOf(a) == INT_TYPE)
+    {
+        return intValue(a);
+    }
+    double value = 0;
+    for (int i = a->big.length - 1; i >= 0; i--)
+    {
+        value = value * (double)DIGIT_BASE + a->big.digits[i];
+    }
+    return a->big.negative ? -value : value;
+}
+
+// Takes a run of decimal digits that need not be null-terminated, how many
+// there are and whether they had a minus sign, and returns the integer they
+// spell
+Item *integerParse(char *digits, int count, bool negative)
+{
+    digit *magnitude = scratch(count / DECIMAL_CHUNK_DIGITS + 2);
+    int length = 0;
+
+    // the first chunk takes whatever is left over, so the rest are whole
+    int chunk = count % DECIMAL_CHUNK_DIGITS;
+    if (chunk == 0)
+    {
+        chunk = DECIMAL_CHUNK_DIGITS;
+    }
+    for (int start = 0; start < count; start += chunk, chunk = DECIMAL_CHUNK_DIGITS)
+    {
+        twoDigits scale = 1;
+        twoDigits carry = 0;
+        for (int i = start; i < start + chunk; i++)
+        {
+            scale *= 10;
+            carry = carry * 10 + (digits[i] - '0');
+        }
+        // magnitude = magnitude * 10^chunk + the chunk
+        for (int i = 0; i < length; i++)
+        {
+            carry += magnitude[i] * scale;
+            magnitude[i] = (digit)carry;
+            carry >>= DIGIT_BITS;
+        }
+        if (carry != 0)
+        {
+            magnitude[length++] = (digit)carry;
+        }
+    }
+
+    Item *result = makeInteger(magnitude, length, negative);
+    free(magnitude);
+    return result;
+}
+
+// Takes a bignum and prints it in decimal, nine digits at a time from a
+// copy that is divided down by 10^9
+void bignumPrint(Item *a)
+{
+    int length = a->big.length;
+    digit *rest = scratch(length);
+    memcpy(rest, a->big.digits, length * sizeof(digit));
+    // each digit holds fewer than 10 decimal digits, so fewer than 2 chunks
+    digit *chunks = scratch(2 * length);
+    int count = 0;
+    while (length > 0)
+    {
+        chunks[count++] = divideByDigit(rest, length, DECIMAL_CHUNK);
+        length = trim(rest, length);
+    }
+
+    if (a->big.negative)
+    {
+        printf("-");
+    }
+    printf("%u", chunks[count - 1]);
+    for (int i = count - 2; i >= 0; i--)
+    {
+        printf("%09u", chunks[i]);
+    }
+    free(rest);
+    free(chunks);
+}
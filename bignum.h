@@ -0,0 +1,48 @@
+#include <stdbool.h>
+#include "item.h"
+
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+// Integers are immediate while they fit in an int, and bignums once they do
+// not. The functions below take and return either kind, promoting a result to
+// a bignum when it overflows an int and demoting it back as soon as it fits
+// again, so a value always has exactly one representation.
+
+// Returns true if the item is an integer of either kind
+static inline bool isInteger(Item *item)
+{
+    itemType type = typeOf(item);
+    return type == INT_TYPE || type == BIGNUM_TYPE;
+}
+
+// Takes two integers and returns their sum
+Item *integerAdd(Item *a, Item *b);
+
+// Takes two integers and returns a - b
+Item *integerSubtract(Item *a, Item *b);
+
+// Takes two integers and returns their product
+Item *integerMultiply(Item *a, Item *b);
+
+// Takes two integers and returns a / b rounded towards zero, storing the
+// remainder, which has the sign of a, through the given pointer. Produces an
+// evaluation error if b is zero.
+Item *integerDivide(Item *a, Item *b, Item **remainder);
+
+// Takes two integers and returns a negative number, zero or a positive number
+// as a is less than, equal to or greater than b
+int integerCompare(Item *a, Item *b);
+
+// Takes an integer and returns the nearest double
+double integerToDouble(Item *a);
+
+// Takes a run of decimal digits that need not be null-terminated, how many
+// there are and whether they had a minus sign, and returns the integer they
+// spell
+Item *integerParse(char *digits, int count, bool negative);
+
+// Takes a bignum and prints it in decimal
+void bignumPrint(Item *a);
+
+#endif
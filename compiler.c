@@ -0,0 +1,725 @@
+#include <stdlib.h>
+#include <string.h>
+#include "item.h"
+#include "talloc.h"
+#include "gc.h"
+#include "linkedlist.h"
+#include "symbols.h"
+#include "interpreter.h"
+#include "compiler.h"
+
+// The unit being built: the heap items its code refers to (quoted data,
+// strings, doubles, names, global references and the code of each lambda),
+// and the pinned blocks holding the code itself. Both are roots until the unit
+// is finished, and are then emptied for the next one.
+static Item **constants = NULL;
+static size_t constantCount = 0;
+static size_t constantCapacity = 0;
+static void **blocks = NULL;
+static size_t blockCount = 0;
+static size_t blockCapacity = 0;
+
+static Item *elseSymbol = NULL;
+
+static void compileExpression(Item *expression, Code *code, bool tail);
+
+// Takes a pointer to a growable array of pointers, its count and capacity,
+// and appends the given pointer to it, growing it out of talloc when it is full
+static void append(void ***array, size_t *count, size_t *capacity, void *pointer)
+{
+    if (constants == NULL && blocks == NULL)
+    {
+        gcAddRoots((void ***)&constants, &constantCount);
+        gcAddRoots(&blocks, &blockCount);
+    }
+    if (*count == *capacity)
+    {
+        // the old array is simply left behind in the arena
+        size_t grown = *capacity == 0 ? 256 : *capacity * 2;
+        void **copy = talloc(grown * sizeof(void *));
+        if (*count > 0)
+        {
+            memcpy(copy, *array, *count * sizeof(void *));
+        }
+        *array = copy;
+        *capacity = grown;
+    }
+    (*array)[(*count)++] = pointer;
+}
+
+// Takes an item and returns the index of a new constant of the unit being
+// built holding it
+int addConstant(Item *item)
+{
+    append((void ***)&constants, &constantCount, &constantCapacity, item);
+    return constantCount - 1;
+}
+
+// Takes a size in bytes and returns a new, zeroed block that never moves and
+// lives as long as the unit being built
+void *unitAlloc(size_t size)
+{
+    void *block = gcPinnedData(size);
+    append(&blocks, &blockCount, &blockCapacity, block);
+    return block;
+}
+
+// Takes the address of some code or node and returns a PTR_TYPE item pointing
+// at it, which is not part of a unit yet
+static Item *codeItem(void *address)
+{
+    Item *item = gcItem();
+    item->type = PTR_TYPE;
+    item->code.address = address;
+    return item;
+}
+
+// Takes the code or node the unit being built is entered by and finishes the
+// unit: its constants, then its blocks, go in a pinned frame, which every code
+// item made for the unit is pointed at. Returns a code item for the entry.
+Item *finishUnit(void *entry)
+{
+    Item *item = codeItem(entry);
+    Frame *unit = gcPinnedFrame(constantCount + blockCount);
+    memcpy(unit->slots, constants, constantCount * sizeof(Item *));
+    memcpy(unit->slots + constantCount, blocks, blockCount * sizeof(void *));
+    gcWriteBarrier(unit);
+    for (size_t i = 0; i < constantCount; i++)
+    {
+        // the unit is old, so pointing at it needs no write barrier
+        if (typeOf(constants[i]) == PTR_TYPE && constants[i]->code.unit == NULL)
+        {
+            constants[i]->code.unit = unit;
+        }
+    }
+    item->code.unit = unit;
+    constantCount = 0;
+    blockCount = 0;
+    return item;
+}
+
+// Returns a new, empty piece of code
+static Code *newCode()
+{
+    Code *code = unitAlloc(sizeof(Code));
+    code->capacity = 16;
+    code->ops = unitAlloc(code->capacity * sizeof(intptr_t));
+    code->length = 0;
+    code->arity = 0;
+    code->variadic = false;
+    code->threaded = false;
+    code->names = addConstant(makeNull());
+    return code;
+}
+
+// Takes a piece of code and a word and appends the word to it. Returns the
+// index of the word, so that a jump target can be patched in later.
+static int emit(Code *code, intptr_t word)
+{
+    if (code->length == code->capacity)
+    {
+        // the old instructions are simply left behind in the unit
+        intptr_t *grown = unitAlloc(code->capacity * 2 * sizeof(intptr_t));
+        memcpy(grown, code->ops, code->length * sizeof(intptr_t));
+        code->ops = grown;
+        code->capacity *= 2;
+    }
+    code->ops[code->length] = word;
+    return code->length++;
+}
+
+// Takes a piece of code and the index of a jump operand and points the jump
+// at the next instruction to be emitted
+static void patch(Code *code, int jump)
+{
+    code->ops[jump] = code->length;
+}
+
+// Takes a piece of code and an error message and emits an instruction that
+// stops with that error when it is reached
+static void emitError(Code *code, char *error)
+{
+    emit(code, OP_ERROR);
+    emit(code, (intptr_t)error);
+}
+
+// Takes an item and emits an instruction that pushes it unevaluated
+static void emitConstant(Item *item, Code *code)
+{
+    if (isImmediate(item))
+    {
+        emit(code, OP_IMMEDIATE);
+        emit(code, (intptr_t)item);
+    }
+    else
+    {
+        emit(code, OP_CONST);
+        emit(code, addConstant(item));
+    }
+}
+
+// Takes a body of expressions and emits them in order, keeping only the value
+// of the last one, which is in tail position if tail is set. Emits the given
+// error instead if the body is empty.
+static void compileBody(Item *body, Code *code, char *error, bool tail)
+{
+    if (isNull(body))
+    {
+        emitError(code, error);
+        return;
+    }
+    while (!isNull(cdr(body)))
+    {
+        compileExpression(car(body), code, false);
+        emit(code, OP_POP);
+        body = cdr(body);
+    }
+    compileExpression(car(body), code, tail);
+}
+
+// Takes the bindings of a let, let* or letrec in the style of ((x 3) (y 4))
+// and returns how many there are, or -1 after emitting the error the
+// interpreter gives for a malformed binding list
+static int countBindings(Item *bindings, Code *code)
+{
+    if (typeOf(bindings) != CONS_TYPE)
+    {
+        emitError(code, "Incorrect let format");
+        return -1;
+    }
+    if (isNull(car(bindings)) && isNull(cdr(bindings)))
+    {
+        // no bindings, because () parses as a list holding ()
+        return 0;
+    }
+    if (typeOf(car(bindings)) != CONS_TYPE)
+    {
+        emitError(code, "Incorrect let body format");
+        return -1;
+    }
+    if (isNull(car(car(bindings))) && isNull(cdr(car(bindings))))
+    {
+        emitError(code, "args has a null binding");
+        return -1;
+    }
+    return length(bindings);
+}
+
+// Takes a binding in the style of (x 3) and returns true if it names a symbol,
+// emitting the interpreter's error otherwise
+static bool checkBinding(Item *binding, Code *code)
+{
+    if (typeOf(binding) != CONS_TYPE || typeOf(car(binding)) != SYMBOL_TYPE)
+    {
+        emitError(code, "Tyring to get value of non symbol");
+        return false;
+    }
+    return true;
+}
+
+// Takes the arguments of a let and emits its bindings, each evaluated in the
+// current frame, and its body in a new frame holding them
+static void compileLet(Item *args, Code *code, bool tail)
+{
+    int count = countBindings(car(args), code);
+    if (count < 0)
+    {
+        return;
+    }
+
+    Item *bindings = count > 0 ? car(args) : makeNull();
+    for (Item *current = bindings; !isNull(current); current = cdr(current))
+    {
+        if (!checkBinding(car(current), code))
+        {
+            return;
+        }
+        for (Item *later = cdr(current); !isNull(later); later = cdr(later))
+        {
+            if (typeOf(car(later)) == CONS_TYPE && car(car(later)) == car(car(current)))
+            {
+                emitError(code, "duplicate binding");
+                return;
+            }
+        }
+        compileExpression(car(cdr(car(current))), code, false);
+    }
+
+    emit(code, OP_PUSH_FRAME);
+    emit(code, count);
+    emit(code, count);
+    emit(code, addConstant(bindings));
+    compileBody(cdr(args), code, "no args following the bindings in let", tail);
+    emit(code, OP_POP_FRAME);
+    emit(code, 1);
+}
+
+// Takes the arguments of a let* and emits an empty frame followed by one frame
+// per binding, so that later bindings can see and shadow earlier ones
+static void compileLetStar(Item *args, Code *code, bool tail)
+{
+    int count = countBindings(car(args), code);
+    if (count < 0)
+    {
+        return;
+    }
+
+    emit(code, OP_PUSH_FRAME);
+    emit(code, 0);
+    emit(code, 0);
+    emit(code, addConstant(makeNull()));
+    Item *bindings = count > 0 ? car(args) : makeNull();
+    for (Item *current = bindings; !isNull(current); current = cdr(current))
+    {
+        if (!checkBinding(car(current), code))
+        {
+            return;
+        }
+        compileExpression(car(cdr(car(current))), code, false);
+        emit(code, OP_PUSH_FRAME);
+        emit(code, 1);
+        emit(code, 1);
+        emit(code, addConstant(current));
+    }
+    compileBody(cdr(args), code, "no args following the bindings in let", tail);
+    emit(code, OP_POP_FRAME);
+    emit(code, count + 1);
+}
+
+// Takes the arguments of a letrec and emits a new frame, its bindings
+// evaluated in that frame, and its body. The slots are only filled once every
+// value has been evaluated.
+static void compileLetRec(Item *args, Code *code, bool tail)
+{
+    if (typeOf(car(args)) != CONS_TYPE)
+    {
+        emitError(code, "Incorrect let format");
+        return;
+    }
+    if (isNull(cdr(args)))
+    {
+        emitError(code, "args following the bindings in let");
+        return;
+    }
+    int count = countBindings(car(args), code);
+    if (count < 0)
+    {
+        return;
+    }
+
+    Item *bindings = count > 0 ? car(args) : makeNull();
+    emit(code, OP_PUSH_FRAME);
+    emit(code, count);
+    emit(code, 0);
+    emit(code, addConstant(bindings));
+    for (Item *current = bindings; !isNull(current); current = cdr(current))
+    {
+        if (!checkBinding(car(current), code))
+        {
+            return;
+        }
+        compileExpression(car(cdr(car(current))), code, false);
+    }
+    emit(code, OP_FILL_FRAME);
+    emit(code, count);
+    compileBody(cdr(args), code, "no args following the bindings in let", tail);
+    emit(code, OP_POP_FRAME);
+    emit(code, 1);
+}
+
+// Takes the arguments of a lambda and emits a closure over the code of its
+// body, which is compiled here once rather than every time the closure is made
+static void compileLambda(Item *args, Code *code)
+{
+    if (isNull(cdr(args)))
+    {
+        emitError(code, "No code");
+        return;
+    }
+
+    Code *body = newCode();
+    Item *params = car(args);
+    if (typeOf(params) == SYMBOL_TYPE)
+    {
+        // (lambda args ...) gets all of its arguments as one list
+        body->arity = 1;
+        body->variadic = true;
+        constants[body->names] = params;
+    }
+    else if (typeOf(params) == CONS_TYPE)
+    {
+        Item *names = makeNull();
+        for (Item *current = params; !isNull(current); current = cdr(current))
+        {
+            Item *name = car(current);
+            if (isNull(name))
+            {
+                // an empty parameter list parses as a list holding ()
+                continue;
+            }
+            if (typeOf(name) != SYMBOL_TYPE)
+            {
+                emitError(code, "Must be symbol");
+                return;
+            }
+            if (inList(name, names))
+            {
+                emitError(code, "Duplicate symbol");
+                return;
+            }
+            names = cons(name, names);
+            body->arity++;
+        }
+        constants[body->names] = reverse(names);
+    }
+
+    compileBody(cdr(args), body, "No code", true);
+    emit(body, OP_RETURN);
+
+    emit(code, OP_CLOSURE);
+    emit(code, addConstant(codeItem(body)));
+}
+
+// Takes the arguments of a set! and emits the assignment
+static void compileSet(Item *args, Code *code)
+{
+    if (isNull(cdr(args)) || !isNull(cdr(cdr(args))))
+    {
+        emitError(code, "incorrect n.o. arguments");
+        return;
+    }
+
+    Item *variable = car(args);
+    compileExpression(car(cdr(args)), code, false);
+    switch (typeOf(variable))
+    {
+    case LOCAL_TYPE:
+        emit(code, OP_SET_LOCAL);
+        emit(code, variable->lr.depth);
+        emit(code, variable->lr.index);
+        break;
+    case GLOBAL_TYPE:
+        emit(code, OP_SET_GLOBAL);
+        emit(code, addConstant(variable));
+        break;
+    case SYMBOL_TYPE:
+        emit(code, OP_SET_NAME);
+        emit(code, addConstant(variable));
+        break;
+    default:
+        emitError(code, "symbol not found: ");
+        break;
+    }
+}
+
+// Takes the arguments of a set-car! or set-cdr! and the instruction that does
+// the assignment, and emits it
+static void compileSetPair(Item *args, opcode op, Code *code)
+{
+    if (isNull(cdr(args)) || !isNull(cdr(cdr(args))))
+    {
+        emitError(code, "incorrect n.o. arguments");
+        return;
+    }
+    compileExpression(car(args), code, false);
+    compileExpression(car(cdr(args)), code, false);
+    emit(code, op);
+}
+
+// Takes the arguments of an and or an or, and whether it is an and, and emits
+// code that stops at the first false or true value respectively. Like the
+// interpreter, the result is always #t or #f.
+static void compileAndOr(Item *args, bool isAnd, Code *code)
+{
+    // the jumps taken when the search stops early
+    Item *exits = makeNull();
+    for (; !isNull(args); args = cdr(args))
+    {
+        compileExpression(car(args), code, false);
+        emit(code, OP_JUMP_IF_FALSE);
+        int jump = emit(code, 0);
+        if (isAnd)
+        {
+            exits = cons(makeInt(jump), exits);
+        }
+        else
+        {
+            emit(code, OP_JUMP);
+            exits = cons(makeInt(emit(code, 0)), exits);
+            patch(code, jump);
+        }
+    }
+
+    emitConstant(makeBool(isAnd), code);
+    emit(code, OP_JUMP);
+    int end = emit(code, 0);
+    for (; !isNull(exits); exits = cdr(exits))
+    {
+        patch(code, intValue(car(exits)));
+    }
+    emitConstant(makeBool(!isAnd), code);
+    patch(code, end);
+}
+
+// Takes the clauses of a cond and emits a test for each in turn. As in the
+// interpreter, only the first expression of a clause is evaluated, and a
+// clause with no expression, or no true clause at all, gives void.
+static void compileCond(Item *clauses, Code *code, bool tail)
+{
+    Item *exits = makeNull();
+    for (; !isNull(clauses); clauses = cdr(clauses))
+    {
+        Item *clause = car(clauses);
+        if (isNull(clause))
+        {
+            emitError(code, "Empty condition in cond");
+            break;
+        }
+        if (car(clause) == elseSymbol)
+        {
+            if (isNull(cdr(clause)))
+            {
+                emitError(code, "Else without following expression");
+            }
+            else
+            {
+                compileExpression(car(cdr(clause)), code, tail);
+            }
+            break;
+        }
+
+        compileExpression(car(clause), code, false);
+        emit(code, OP_JUMP_IF_FALSE);
+        int next = emit(code, 0);
+        if (isNull(cdr(clause)))
+        {
+            emitConstant(VOID_ITEM, code);
+        }
+        else
+        {
+            compileExpression(car(cdr(clause)), code, tail);
+        }
+        emit(code, OP_JUMP);
+        exits = cons(makeInt(emit(code, 0)), exits);
+        patch(code, next);
+    }
+    if (isNull(clauses))
+    {
+        emitConstant(VOID_ITEM, code);
+    }
+    for (; !isNull(exits); exits = cdr(exits))
+    {
+        patch(code, intValue(car(exits)));
+    }
+}
+
+// Takes a list headed by a special form or a procedure, and whether it is in
+// tail position, and emits it, checking each special form the way eval does
+static void compileForm(Item *form, Code *code, bool tail)
+{
+    Item *args = cdr(form);
+    formId id = formOf(car(form));
+    switch (id)
+    {
+    case FORM_IF:
+    {
+        if (typeOf(args) == NULL_TYPE || typeOf(cdr(args)) == NULL_TYPE)
+        {
+            emitError(code, "incorrect if format");
+            break;
+        }
+        compileExpression(car(args), code, false);
+        emit(code, OP_JUMP_IF_FALSE);
+        int alternative = emit(code, 0);
+        compileExpression(car(cdr(args)), code, tail);
+        emit(code, OP_JUMP);
+        int end = emit(code, 0);
+        patch(code, alternative);
+        if (isNull(cdr(cdr(args))))
+        {
+            emitConstant(VOID_ITEM, code);
+        }
+        else
+        {
+            compileExpression(car(cdr(cdr(args))), code, tail);
+        }
+        patch(code, end);
+        break;
+    }
+    case FORM_LET:
+    {
+        compileLet(args, code, tail);
+        break;
+    }
+    case FORM_DISPLAY:
+    {
+        if (isNull(args))
+        {
+            emitError(code, "incorrect display format");
+            break;
+        }
+        compileExpression(car(args), code, false);
+        emit(code, OP_DISPLAY);
+        break;
+    }
+    case FORM_NEWLINE:
+    {
+        emit(code, OP_NEWLINE);
+        break;
+    }
+    case FORM_LET_STAR:
+    {
+        compileLetStar(args, code, tail);
+        break;
+    }
+    case FORM_LETREC:
+    {
+        compileLetRec(args, code, tail);
+        break;
+    }
+    case FORM_QUOTE:
+    {
+        if (typeOf(args) == NULL_TYPE || typeOf(cdr(args)) != NULL_TYPE)
+        {
+            emitError(code, "incorrect quote format");
+            break;
+        }
+        emitConstant(car(args), code);
+        break;
+    }
+    case FORM_DEFINE:
+    {
+        if (isNull(args))
+        {
+            emitError(code, "Incorrect form");
+            break;
+        }
+        if (isNull(cdr(args)) || typeOf(car(args)) != SYMBOL_TYPE)
+        {
+            emitError(code, "incorrect define format");
+            break;
+        }
+        compileExpression(car(cdr(args)), code, false);
+        emit(code, OP_DEFINE);
+        emit(code, addConstant(car(args)));
+        break;
+    }
+    case FORM_LAMBDA:
+    {
+        if (isNull(args))
+        {
+            emitError(code, "incorrect format");
+            break;
+        }
+        compileLambda(args, code);
+        break;
+    }
+    case FORM_SET:
+    case FORM_SET_CAR:
+    case FORM_SET_CDR:
+    {
+        if (isNull(args))
+        {
+            emitError(code, "incorrect format set");
+        }
+        else if (id == FORM_SET)
+        {
+            compileSet(args, code);
+        }
+        else
+        {
+            compileSetPair(args, id == FORM_SET_CAR ? OP_SET_CAR : OP_SET_CDR, code);
+        }
+        break;
+    }
+    case FORM_AND:
+    case FORM_OR:
+    {
+        if (isNull(args))
+        {
+            emitError(code, id == FORM_AND ? "incorrect format and" : "incorrect format or");
+            break;
+        }
+        compileAndOr(args, id == FORM_AND, code);
+        break;
+    }
+    case FORM_COND:
+    {
+        if (typeOf(args) == NULL_TYPE || typeOf(cdr(args)) == NULL_TYPE)
+        {
+            emitError(code, "incorrect cond format");
+            break;
+        }
+        compileCond(args, code, tail);
+        break;
+    }
+    default:
+    {
+        // a procedure call: the procedure, then its arguments in order
+        int count = 0;
+        for (Item *current = form; !isNull(current); current = cdr(current))
+        {
+            compileExpression(car(current), code, false);
+            count++;
+        }
+        arithmeticOp op = ARITHMETIC_NONE;
+        if (typeOf(car(form)) == GLOBAL_TYPE && count == 3)
+        {
+            op = arithmeticOperation(car(form)->gr.name);
+        }
+        if (op != ARITHMETIC_NONE)
+        {
+            emit(code, OP_ARITHMETIC);
+            emit(code, op);
+            emit(code, tail);
+            break;
+        }
+        emit(code, tail ? OP_TAIL_CALL : OP_CALL);
+        emit(code, count - 1);
+        break;
+    }
+    }
+}
+
+// Takes an expression, and whether it is in tail position, and emits code
+// that leaves its value on the stack
+static void compileExpression(Item *expression, Code *code, bool tail)
+{
+    switch (typeOf(expression))
+    {
+    case LOCAL_TYPE:
+        emit(code, OP_LOCAL);
+        emit(code, expression->lr.depth);
+        emit(code, expression->lr.index);
+        break;
+    case GLOBAL_TYPE:
+        emit(code, OP_GLOBAL);
+        emit(code, addConstant(expression));
+        break;
+    case SYMBOL_TYPE:
+        emit(code, OP_NAME);
+        emit(code, addConstant(expression));
+        break;
+    case CONS_TYPE:
+        compileForm(expression, code, tail);
+        break;
+    default:
+        emitConstant(expression, code);
+        break;
+    }
+}
+
+// Takes a top-level form that has been through resolve() and returns a code
+// item holding its bytecode
+Item *compile(Item *form)
+{
+    if (elseSymbol == NULL)
+    {
+        elseSymbol = intern("else");
+    }
+
+    Code *code = newCode();
+    compileExpression(form, code, true);
+    emit(code, OP_RETURN);
+    return finishUnit(code);
+}
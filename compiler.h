@@ -0,0 +1,94 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "item.h"
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+// The instructions of the bytecode VM. Each is one word followed by its
+// operands, also one word each. Constants that live in the heap are referred
+// to by their index in the constants of the code's unit (see below); immediate
+// items are operands themselves. Jump targets are indexes into the
+// instructions. A form that is malformed compiles to an OP_ERROR where the
+// interpreter would have stopped, so the error is only raised if that point is
+// reached.
+typedef enum
+{
+    OP_IMMEDIATE,     // item: push the immediate item
+    OP_CONST,         // k: push constant k
+    OP_LOCAL,         // depth index: push a frame slot
+    OP_SET_LOCAL,     // depth index: pop into a frame slot, push void
+    OP_GLOBAL,        // k: push the global named by GLOBAL_TYPE constant k
+    OP_SET_GLOBAL,    // k: pop into that global, push void
+    OP_NAME,          // k: push the variable named by symbol constant k
+    OP_SET_NAME,      // k: pop into that variable, push void
+    OP_DEFINE,        // k: pop into a new binding of symbol constant k, push void
+    OP_POP,           // discard the top of the stack
+    OP_JUMP,          // target
+    OP_JUMP_IF_FALSE, // target: pop, and jump if it was #f
+    OP_CLOSURE,       // k: push a closure over the current frame of code constant k
+    OP_CALL,          // n: call the procedure below the top n arguments
+    OP_TAIL_CALL,     // n: as OP_CALL, but a closure replaces the current
+                      // procedure instead of returning to it
+    OP_ARITHMETIC,    // op tail: as OP_CALL 2, or OP_TAIL_CALL 2 if tail is
+                      // set, to the global bound to the primitive for op,
+                      // made inline if it still is and both arguments are
+                      // integers
+    OP_RETURN,        // return the top of the stack to the caller
+    OP_PUSH_FRAME,    // size filled k: make a frame of size slots named by
+                      // constant k, pop filled values into its first slots, and
+                      // make it the current frame
+    OP_FILL_FRAME,    // n: pop n values into the slots of the current frame
+    OP_POP_FRAME,     // n: go back n frames up the current frame's parents
+    OP_DISPLAY,       // pop and print, push void
+    OP_NEWLINE,       // print a newline, push void
+    OP_SET_CAR,       // pop a value and a pair, set the pair's car, push void
+    OP_SET_CDR,       // pop a value and a pair, set the pair's cdr, push void
+    OP_ERROR          // message: stop with an evaluation error
+} opcode;
+
+// The bytecode of a procedure body or a top-level form. A procedure's frame
+// has arity slots, named by constant names; a variadic procedure has a single
+// slot holding the list of its arguments. Once the VM has threaded the code,
+// each instruction is the address of the VM code that runs it rather than an
+// opcode.
+typedef struct Code
+{
+    intptr_t *ops;
+    int length;
+    int capacity;
+    int arity;
+    bool variadic;
+    bool threaded;
+    int names;
+} Code;
+
+// Compiled and analysed code is made a unit at a time: one top-level form for
+// the VM, or one lambda body for the analyser. The code and nodes of a unit
+// live in pinned blocks, so they can point at each other, but the heap items
+// they refer to might move, so those are kept in the unit's constants and
+// found by index. A finished unit is a pinned frame holding its constants and
+// then its blocks, and PTR_TYPE code items point at it, so the whole unit is
+// collected once nothing that could run it is left.
+
+// Takes a top-level form that has been through resolve() and returns a code
+// item holding its bytecode, as a unit of its own. Every lambda inside it is
+// compiled into the same unit.
+Item *compile(Item *form);
+
+// Takes an item and returns the index of a new constant of the unit being
+// built holding it. Constants are roots, and are updated when their items
+// move.
+int addConstant(Item *item);
+
+// Takes a size in bytes and returns a new, zeroed block that never moves and
+// lives as long as the unit being built.
+void *unitAlloc(size_t size);
+
+// Takes the code or node the unit being built is entered by, and finishes the
+// unit. Returns a code item for the entry; its unit's slots, from index 0,
+// are the constants.
+Item *finishUnit(void *entry);
+
+#endif
@@ -0,0 +1,722 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "item.h"
+#include "talloc.h"
+#include "gc.h"
+
+// New objects are bumped into a nursery. A minor collection copies whatever
+// is still reachable out of it into the old space and then starts the nursery
+// over, so the many objects that die young cost nothing to reclaim.
+//
+// The old space is made of pages, and every page holds cells of a single size
+// class. Free cells are threaded onto a per-class free list through their
+// payload, and a major collection marks and sweeps it. Objects too big for
+// any class, such as frames with many slots, each get a block of their own.
+//
+// Every object starts with a small header holding what kind of object it is,
+// its mark bit, whether it has been forwarded (young objects) or is in the
+// remembered set (old objects), and whether it is permanent and must never be
+// swept.
+//
+// Every minor collection looks at every root, however few of them point into
+// the nursery, so deep recursion with its many roots would make each one
+// slower. The nursery grows to GC_ROOT_BYTES for every root instead, keeping
+// the time spent on roots in proportion to what was allocated, and shrinks
+// again once they are gone.
+#define GC_NURSERY_SIZE (256 * 1024)
+#define GC_ROOT_BYTES 32
+#define GC_PAGE_SIZE (64 * 1024)
+#define GC_GRANULE 8
+#define GC_CLASSES 32
+#define GC_MIN_THRESHOLD (1 << 20)
+
+typedef enum
+{
+    GC_FREE,
+    GC_ITEM,
+    GC_FRAME,
+    GC_DATA
+} gcKind;
+
+typedef struct GcHeader
+{
+    unsigned char kind;
+    unsigned char marked;
+    unsigned char forwarded;
+    unsigned char remembered;
+    unsigned char permanent;
+    unsigned short size;
+} GcHeader;
+
+typedef struct GcPage
+{
+    struct GcPage *next;
+    size_t stride;
+    size_t used;
+    char *cells;
+} GcPage;
+
+typedef struct GcLarge
+{
+    struct GcLarge *next;
+    size_t size;
+    GcHeader header;
+} GcLarge;
+
+static char *nursery = NULL;
+static size_t nurserySize = 0;
+static size_t nurseryUsed = 0;
+
+static GcPage *pages[GC_CLASSES];
+static GcHeader *freeList[GC_CLASSES];
+static GcLarge *largeObjects = NULL;
+
+// The root stack holds addresses of pointer variables, so it always sees
+// their current values.
+static void ***roots = NULL;
+static size_t rootCount = 0;
+static size_t rootCapacity = 0;
+
+// Arrays of roots registered for the whole run, such as the VM's stack
+#define GC_MAX_AREAS 8
+static void ***areas[GC_MAX_AREAS];
+static size_t *areaCounts[GC_MAX_AREAS];
+static int areaCount = 0;
+
+// Old objects that may point into the nursery. They are scanned as extra
+// roots by the next minor collection.
+static void **remembered = NULL;
+static size_t rememberedCount = 0;
+static size_t rememberedCapacity = 0;
+
+// Objects waiting to have their children marked (major collections) or
+// promoted (minor collections).
+static void **markStack = NULL;
+static size_t markCount = 0;
+static size_t markCapacity = 0;
+
+static size_t promotedSinceCollection = 0;
+static size_t threshold = GC_MIN_THRESHOLD;
+static size_t heapSize = 0;
+
+static size_t objectsAllocated = 0;
+static size_t bytesAllocated = 0;
+static size_t minorCollections = 0;
+static size_t majorCollections = 0;
+static size_t bytesPromoted = 0;
+static size_t bytesReclaimed = 0;
+static double totalPause = 0;
+static double maxPause = 0;
+
+// Returns the current time in milliseconds
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Takes a pointer to the payload of a heap object and returns its header
+static GcHeader *headerOf(void *object)
+{
+    return (GcHeader *)object - 1;
+}
+
+// Takes a pointer to a stack of pointers, its count and capacity, and pushes
+// the given pointer on it, growing the stack out of talloc when it is full
+static void pushPointer(void ***stack, size_t *count, size_t *capacity, void *pointer)
+{
+    if (*count == *capacity)
+    {
+        // the old stack is simply left behind in the arena
+        size_t grown = *capacity == 0 ? 1024 : *capacity * 2;
+        void **copy = talloc(grown * sizeof(void *));
+        if (*count > 0)
+        {
+            memcpy(copy, *stack, *count * sizeof(void *));
+        }
+        *stack = copy;
+        *capacity = grown;
+    }
+    (*stack)[(*count)++] = pointer;
+}
+
+// Takes an Item or Frame pointer and returns true if it points into the heap
+// at all, rather than being NULL or an immediate item
+static bool isHeapObject(void *object)
+{
+    return object != NULL && !isImmediate(object);
+}
+
+// Takes a pointer to a heap object and returns true if it is in the nursery
+static bool isYoung(void *object)
+{
+    return (char *)object >= nursery && (char *)object < nursery + nurserySize;
+}
+
+// Takes a size class and returns a new page of cells of that class
+static GcPage *newPage(int sizeClass)
+{
+    GcPage *page = talloc(sizeof(GcPage));
+    page->stride = sizeof(GcHeader) + (sizeClass + 1) * GC_GRANULE;
+    page->used = 0;
+    page->cells = talloc(GC_PAGE_SIZE);
+    page->next = pages[sizeClass];
+    pages[sizeClass] = page;
+    heapSize += GC_PAGE_SIZE;
+    return page;
+}
+
+// Takes a kind and a payload size too big for any size class and returns an
+// old space object in a block of its own, with the payload left uninitialized.
+// Its size is kept in the block, since it may not fit in the header.
+static void *largeAlloc(gcKind kind, size_t size)
+{
+    GcLarge *large = malloc(sizeof(GcLarge) + size);
+    if (large == NULL)
+    {
+        printf("Out of memory: object of %zu bytes is too large\n", size);
+        texit(1);
+    }
+    large->next = largeObjects;
+    large->size = size;
+    largeObjects = large;
+
+    GcHeader *header = &large->header;
+    header->kind = kind;
+    header->marked = 0;
+    header->forwarded = 0;
+    header->remembered = 0;
+    header->permanent = 0;
+    header->size = 0;
+    heapSize += size;
+    promotedSinceCollection += sizeof(GcHeader) + size;
+    return header + 1;
+}
+
+// Takes a kind and a payload size and returns an old space object with the
+// payload left uninitialized, reusing a free cell of the right class when
+// there is one
+static void *oldAlloc(gcKind kind, size_t size)
+{
+    int sizeClass = (size + GC_GRANULE - 1) / GC_GRANULE - 1;
+    if (sizeClass >= GC_CLASSES)
+    {
+        return largeAlloc(kind, size);
+    }
+
+    GcHeader *header = freeList[sizeClass];
+    if (header != NULL)
+    {
+        freeList[sizeClass] = *(GcHeader **)(header + 1);
+    }
+    else
+    {
+        GcPage *page = pages[sizeClass];
+        if (page == NULL || page->used + page->stride > GC_PAGE_SIZE)
+        {
+            page = newPage(sizeClass);
+        }
+        header = (GcHeader *)(page->cells + page->used);
+        page->used += page->stride;
+    }
+
+    header->kind = kind;
+    header->marked = 0;
+    header->forwarded = 0;
+    header->remembered = 0;
+    header->permanent = 0;
+    header->size = (sizeClass + 1) * GC_GRANULE;
+    promotedSinceCollection += sizeof(GcHeader) + header->size;
+    return header + 1;
+}
+
+// Takes a kind and a payload size and returns a zeroed object from the
+// nursery. If the nursery fills up before the next safepoint, the object goes
+// straight to the old space instead, and is remembered because whatever the
+// caller stores in it may well be young.
+static void *youngAlloc(gcKind kind, size_t size)
+{
+    size = (size + GC_GRANULE - 1) / GC_GRANULE * GC_GRANULE;
+    objectsAllocated++;
+    bytesAllocated += sizeof(GcHeader) + size;
+    if (nursery == NULL)
+    {
+        nursery = malloc(GC_NURSERY_SIZE);
+        nurserySize = GC_NURSERY_SIZE;
+    }
+
+    void *object;
+    if (size > USHRT_MAX || nurseryUsed + sizeof(GcHeader) + size > nurserySize)
+    {
+        // too big for the header to record, or for what is left of the nursery
+        object = oldAlloc(kind, size);
+        gcWriteBarrier(object);
+    }
+    else
+    {
+        GcHeader *header = (GcHeader *)(nursery + nurseryUsed);
+        nurseryUsed += sizeof(GcHeader) + size;
+        header->kind = kind;
+        header->marked = 0;
+        header->forwarded = 0;
+        header->remembered = 0;
+        header->permanent = 0;
+        header->size = size;
+        object = header + 1;
+    }
+    memset(object, 0, size);
+    return object;
+}
+
+// Returns a pointer to a new, zeroed item from the collected heap.
+Item *gcItem()
+{
+    return youngAlloc(GC_ITEM, sizeof(Item));
+}
+
+// Takes a number of slots and returns a pointer to a new, zeroed frame with
+// that many slots from the collected heap.
+Frame *gcFrame(int size)
+{
+    Frame *frame = youngAlloc(GC_FRAME, sizeof(Frame) + size * sizeof(Item *));
+    frame->size = size;
+    return frame;
+}
+
+// Takes a size in bytes and returns a pointer to a new, zeroed block from the
+// collected heap that holds no pointers.
+void *gcData(size_t size)
+{
+    return youngAlloc(GC_DATA, size);
+}
+
+// Takes a kind and a payload size and returns a zeroed object that starts out
+// in the old space, so it is never moved
+static void *pinnedAlloc(gcKind kind, size_t size)
+{
+    size = (size + GC_GRANULE - 1) / GC_GRANULE * GC_GRANULE;
+    objectsAllocated++;
+    bytesAllocated += sizeof(GcHeader) + size;
+    void *object = oldAlloc(kind, size);
+    memset(object, 0, size);
+    return object;
+}
+
+// Takes a number of slots and returns a pointer to a new, zeroed frame that
+// is never moved.
+Frame *gcPinnedFrame(int size)
+{
+    Frame *frame = pinnedAlloc(GC_FRAME, sizeof(Frame) + size * sizeof(Item *));
+    frame->size = size;
+    return frame;
+}
+
+// Takes a size in bytes and returns a pointer to a new, zeroed block that
+// holds no pointers and is never moved.
+void *gcPinnedData(size_t size)
+{
+    return pinnedAlloc(GC_DATA, size);
+}
+
+// Returns a pointer to a new, zeroed item that is never moved or freed.
+Item *gcPermanentItem()
+{
+    Item *item = oldAlloc(GC_ITEM, sizeof(Item));
+    memset(item, 0, sizeof(Item));
+    headerOf(item)->permanent = 1;
+    return item;
+}
+
+// Takes a pointer to an Item or Frame that is about to be (or has just been)
+// made to point at another object, and remembers it if it is in the old space.
+void gcWriteBarrier(void *object)
+{
+    if (!isHeapObject(object) || isYoung(object))
+    {
+        return;
+    }
+    GcHeader *header = headerOf(object);
+    if (!header->remembered)
+    {
+        header->remembered = 1;
+        pushPointer(&remembered, &rememberedCount, &rememberedCapacity, object);
+    }
+}
+
+// Takes the address of an Item or Frame pointer variable and registers it as
+// a root. The variable must already hold a valid pointer or NULL.
+void gcPush(void *address)
+{
+    pushPointer((void ***)&roots, &rootCount, &rootCapacity, address);
+}
+
+// Returns the current depth of the root stack, to be handed back to gcPop.
+size_t gcDepth()
+{
+    return rootCount;
+}
+
+// Takes a depth returned by gcDepth and unregisters every root pushed since.
+void gcPop(size_t depth)
+{
+    rootCount = depth;
+}
+
+// Takes the address of a growable array of Item or Frame pointers and the
+// address of its count, and registers the first count entries of the array
+// as roots for the rest of the run.
+void gcAddRoots(void ***area, size_t *count)
+{
+    if (areaCount == GC_MAX_AREAS)
+    {
+        printf("Out of memory: too many root areas\n");
+        texit(1);
+    }
+    areas[areaCount] = area;
+    areaCounts[areaCount] = count;
+    areaCount++;
+}
+
+// Takes an Item or Frame pointer and marks what it points to, queueing it so its
+// children get marked too
+static void mark(void *object)
+{
+    if (!isHeapObject(object))
+    {
+        return;
+    }
+    GcHeader *header = headerOf(object);
+    if (header->marked)
+    {
+        return;
+    }
+    header->marked = 1;
+    pushPointer(&markStack, &markCount, &markCapacity, object);
+}
+
+// Takes a marked heap object and marks every object it points to
+static void markChildren(void *object)
+{
+    if (headerOf(object)->kind == GC_DATA)
+    {
+        return;
+    }
+    if (headerOf(object)->kind == GC_FRAME)
+    {
+        Frame *frame = object;
+        mark(frame->parent);
+        mark(frame->names);
+        mark(frame->bindings);
+        for (int i = 0; i < frame->size; i++)
+        {
+            mark(frame->slots[i]);
+        }
+        return;
+    }
+
+    Item *item = object;
+    switch (item->type)
+    {
+    case CONS_TYPE:
+        mark(item->c.car);
+        mark(item->c.cdr);
+        break;
+    case STR_TYPE:
+        if (item->str.collected)
+        {
+            mark(item->str.chars);
+        }
+        break;
+    case PTR_TYPE:
+        mark(item->code.unit);
+        break;
+    case CLOSURE_TYPE:
+        mark(item->cl.paramNames);
+        mark(item->cl.functionCode);
+        mark(item->cl.frame);
+        break;
+    case CONTINUATION_TYPE:
+        mark(item->k.frame);
+        mark(item->k.saved);
+        break;
+    case BIGNUM_TYPE:
+        mark(item->big.digits);
+        break;
+    default:
+        break;
+    }
+}
+
+// Frees every unmarked cell, clears the marks on the rest, and rebuilds the
+// free lists. Returns the number of bytes still live.
+static size_t sweep()
+{
+    size_t live = 0;
+    for (int sizeClass = 0; sizeClass < GC_CLASSES; sizeClass++)
+    {
+        freeList[sizeClass] = NULL;
+        for (GcPage *page = pages[sizeClass]; page != NULL; page = page->next)
+        {
+            for (size_t offset = 0; offset < page->used; offset += page->stride)
+            {
+                GcHeader *header = (GcHeader *)(page->cells + offset);
+                if (header->kind != GC_FREE && (header->marked || header->permanent))
+                {
+                    header->marked = 0;
+                    live += page->stride;
+                    continue;
+                }
+                if (header->kind != GC_FREE)
+                {
+                    header->kind = GC_FREE;
+                    bytesReclaimed += page->stride;
+                }
+                *(GcHeader **)(header + 1) = freeList[sizeClass];
+                freeList[sizeClass] = header;
+            }
+        }
+    }
+
+    GcLarge **link = &largeObjects;
+    while (*link != NULL)
+    {
+        GcLarge *large = *link;
+        if (large->header.marked || large->header.permanent)
+        {
+            large->header.marked = 0;
+            live += large->size;
+            link = &large->next;
+            continue;
+        }
+        *link = large->next;
+        bytesReclaimed += large->size;
+        heapSize -= large->size;
+        free(large);
+    }
+    return live;
+}
+
+// Takes the address of a pointer field or variable and, if it points into the
+// nursery, moves the object it points at to the old space and updates it.
+// The first time an object is moved, a forwarding address is left behind in
+// its place and the copy is queued so its own fields get promoted too.
+static void promote(void **slot)
+{
+    void *object = *slot;
+    if (!isHeapObject(object) || !isYoung(object))
+    {
+        return;
+    }
+    GcHeader *header = headerOf(object);
+    if (header->forwarded)
+    {
+        *slot = *(void **)object;
+        return;
+    }
+
+    void *copy = oldAlloc(header->kind, header->size);
+    memcpy(copy, object, header->size);
+    bytesPromoted += sizeof(GcHeader) + header->size;
+    header->forwarded = 1;
+    *(void **)object = copy;
+    *slot = copy;
+    pushPointer(&markStack, &markCount, &markCapacity, copy);
+}
+
+// Takes an old space object and promotes everything it points to
+static void promoteChildren(void *object)
+{
+    if (headerOf(object)->kind == GC_DATA)
+    {
+        return;
+    }
+    if (headerOf(object)->kind == GC_FRAME)
+    {
+        Frame *frame = object;
+        promote((void **)&frame->parent);
+        promote((void **)&frame->names);
+        promote((void **)&frame->bindings);
+        for (int i = 0; i < frame->size; i++)
+        {
+            promote((void **)&frame->slots[i]);
+        }
+        return;
+    }
+
+    Item *item = object;
+    switch (item->type)
+    {
+    case CONS_TYPE:
+        promote((void **)&item->c.car);
+        promote((void **)&item->c.cdr);
+        break;
+    case STR_TYPE:
+        if (item->str.collected)
+        {
+            promote((void **)&item->str.chars);
+        }
+        break;
+    case PTR_TYPE:
+        promote((void **)&item->code.unit);
+        break;
+    case CLOSURE_TYPE:
+        promote((void **)&item->cl.paramNames);
+        promote((void **)&item->cl.functionCode);
+        promote((void **)&item->cl.frame);
+        break;
+    case CONTINUATION_TYPE:
+        promote((void **)&item->k.frame);
+        promote((void **)&item->k.saved);
+        break;
+    case BIGNUM_TYPE:
+        promote((void **)&item->big.digits);
+        break;
+    default:
+        break;
+    }
+}
+
+// Takes the time a collection started and records its pause
+static void recordPause(double start)
+{
+    double pause = now() - start;
+    totalPause += pause;
+    if (pause > maxPause)
+    {
+        maxPause = pause;
+    }
+}
+
+// Takes the number of roots and, now the nursery is empty, makes it the size
+// that many of them call for, rounded up to GC_NURSERY_SIZE doubled some
+// number of times. It only shrinks once a quarter of it would do, so that a
+// number of roots near a boundary does not swap it back and forth.
+static void resizeNursery(size_t rootsSeen)
+{
+    size_t wanted = GC_NURSERY_SIZE;
+    while (wanted < rootsSeen * GC_ROOT_BYTES)
+    {
+        wanted *= 2;
+    }
+    if (wanted > nurserySize || wanted < nurserySize / 2)
+    {
+        free(nursery);
+        nursery = malloc(wanted);
+        nurserySize = wanted;
+    }
+}
+
+// Empties the nursery, promoting everything reachable from the roots and the
+// remembered set into the old space.
+static void minorCollection()
+{
+    double start = now();
+
+    size_t rootsSeen = rootCount;
+    for (size_t i = 0; i < rootCount; i++)
+    {
+        promote(roots[i]);
+    }
+    for (int area = 0; area < areaCount; area++)
+    {
+        rootsSeen += *areaCounts[area];
+        for (size_t i = 0; i < *areaCounts[area]; i++)
+        {
+            promote(&(*areas[area])[i]);
+        }
+    }
+    for (size_t i = 0; i < rememberedCount; i++)
+    {
+        headerOf(remembered[i])->remembered = 0;
+        promoteChildren(remembered[i]);
+    }
+    rememberedCount = 0;
+    while (markCount > 0)
+    {
+        promoteChildren(markStack[--markCount]);
+    }
+
+    bytesReclaimed += nurseryUsed;
+    nurseryUsed = 0;
+    resizeNursery(rootsSeen);
+    minorCollections++;
+    recordPause(start);
+}
+
+// Marks everything in the old space reachable from the roots and frees
+// everything else. The nursery must be empty.
+static void majorCollection()
+{
+    double start = now();
+
+    for (size_t i = 0; i < rootCount; i++)
+    {
+        mark(*roots[i]);
+    }
+    for (int area = 0; area < areaCount; area++)
+    {
+        for (size_t i = 0; i < *areaCounts[area]; i++)
+        {
+            mark((*areas[area])[i]);
+        }
+    }
+    while (markCount > 0)
+    {
+        markChildren(markStack[--markCount]);
+    }
+    size_t live = sweep();
+
+    promotedSinceCollection = 0;
+    threshold = live > GC_MIN_THRESHOLD ? live : GC_MIN_THRESHOLD;
+    majorCollections++;
+    recordPause(start);
+}
+
+// Empties the nursery, then marks everything reachable from the roots and
+// frees everything else.
+void gcCollect()
+{
+    minorCollection();
+    majorCollection();
+}
+
+// Runs a minor collection once the nursery is mostly full, and a major one
+// once enough has been promoted since the last.
+void gcSafepoint()
+{
+    // leave room for whatever gets allocated before the next safepoint
+    if (nurseryUsed > nurserySize / 4 * 3)
+    {
+        minorCollection();
+    }
+    if (promotedSinceCollection >= threshold)
+    {
+        gcCollect();
+    }
+}
+
+// Prints allocation and collection counts, bytes reclaimed, pause times and
+// the peak resident size of the whole process to stderr.
+void gcPrintStats()
+{
+    size_t collections = minorCollections + majorCollections;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "gc objects allocated: %zu\n", objectsAllocated);
+    fprintf(stderr, "gc bytes allocated:   %zu\n", bytesAllocated);
+    fprintf(stderr, "gc minor collections: %zu\n", minorCollections);
+    fprintf(stderr, "gc major collections: %zu\n", majorCollections);
+    fprintf(stderr, "gc bytes promoted:    %zu\n", bytesPromoted);
+    fprintf(stderr, "gc bytes reclaimed:   %zu\n", bytesReclaimed);
+    fprintf(stderr, "gc old space size:    %zu\n", heapSize);
+    fprintf(stderr, "gc pause total:       %.3f ms\n", totalPause);
+    fprintf(stderr, "gc pause max:         %.3f ms\n", maxPause);
+    fprintf(stderr, "gc pause average:     %.3f ms\n", collections ? totalPause / collections : 0.0);
+    fprintf(stderr, "gc peak resident:     %ld KB\n", usage.ru_maxrss);
+}
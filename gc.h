@@ -0,0 +1,78 @@
+#include <stddef.h>
+#include "item.h"
+
+#ifndef GC_H
+#define GC_H
+
+// Items and frames live in a heap managed by a precise generational
+// collector: new objects start out in a copying nursery and the survivors are
+// promoted to a mark-and-sweep old space. The collector can only run at a
+// safepoint (the start of every eval), so any Item or Frame pointer that a C
+// function keeps in a local variable across a call to eval has to be
+// registered on the root stack with gcPush, and popped again with gcPop before
+// the function returns. Objects can move during a collection, so the variable
+// itself has to be rooted, not some copy of it.
+//
+// Storing a pointer into an object that may have survived a collection (for
+// instance with set!) must be paired with a call to gcWriteBarrier on that
+// object.
+
+// Returns a pointer to a new, zeroed item from the collected heap.
+Item *gcItem();
+
+// Takes a number of slots and returns a pointer to a new, zeroed frame with
+// that many slots from the collected heap.
+Frame *gcFrame(int size);
+
+// Takes a size in bytes and returns a pointer to a new, zeroed block from the
+// collected heap that holds no pointers, such as the digits of a bignum. The
+// collector never looks inside it, and it is only kept alive by an item
+// pointing at it.
+void *gcData(size_t size);
+
+// Takes a number of slots and returns a pointer to a new, zeroed frame that
+// starts out in the old space and so is never moved, which lets C code keep
+// pointers into its slots. Anything stored in it must be followed by
+// gcWriteBarrier, like a store into any old object.
+Frame *gcPinnedFrame(int size);
+
+// Takes a size in bytes and returns a pointer to a new, zeroed block that is
+// never moved. As with gcData the collector never looks inside it, and it is
+// only kept alive by an item or frame pointing at it, but since it stays put,
+// other blocks may hold plain pointers to it.
+void *gcPinnedData(size_t size);
+
+// Returns a pointer to a new, zeroed item that is never moved or freed.
+Item *gcPermanentItem();
+
+// Takes a pointer to an Item or Frame that is about to be (or has just been)
+// made to point at another object, and remembers it if it is in the old space.
+void gcWriteBarrier(void *object);
+
+// Takes the address of an Item or Frame pointer variable and registers it as
+// a root. The variable must already hold a valid pointer or NULL.
+void gcPush(void *address);
+
+// Returns the current depth of the root stack, to be handed back to gcPop.
+size_t gcDepth();
+
+// Takes a depth returned by gcDepth and unregisters every root pushed since.
+void gcPop(size_t depth);
+
+// Takes the address of a growable array of Item or Frame pointers and the
+// address of its count, and registers the first count entries of the array
+// as roots for the rest of the run. Both are read at every collection, so the
+// array may be grown or moved freely.
+void gcAddRoots(void ***area, size_t *count);
+
+// Runs a collection if enough has been allocated since the last one.
+void gcSafepoint();
+
+// Marks everything reachable from the roots and frees everything else.
+void gcCollect();
+
+// Prints allocation and collection counts, bytes reclaimed, pause times and
+// the peak resident size of the whole process to stderr.
+void gcPrintStats();
+
+#endif
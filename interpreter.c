@@ -1,21 +1,39 @@
 #include "tokenizer.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <setjmp.h>
 #include "talloc.h"
+#include "gc.h"
 #include "linkedlist.h"
+#include "symbols.h"
 #include "parser.h"
 #include "string.h"
 #include "interpreter.h"
+#include "vm.h"
+#include "analyzer.h"
+#include "stack.h"
+#include "bignum.h"
 
 Frame *top_frame;
-Item *getsymbolfromframe(char *symbol, Frame *frame);
-void evaluationError(char *error);
-void copy_item(Item *destination, Item *source);
+
+// The interned else symbol, which ends a cond
+Item *elseSymbol;
+
+
+// Takes a double and returns a new item holding it
+Item *makeDouble(double d)
+{
+    Item *item = gcItem();
+    item->type = DOUBLE_TYPE;
+    item->d = d;
+    return item;
+}
 
 // Takes a pointer to item and prints the type of the item for debugging purposes
 void print_type(Item *item)
 {
-    switch (item->type)
+    switch (typeOf(item))
     {
     case INT_TYPE:
         printf("INT_TYPE\n");
@@ -76,9 +94,9 @@ void print_type(Item *item)
 // Takes a pointer to item of symbol type and a pointer to item head of linkedlist and returns 1 if symbol is in list and 0 otherwise.
 bool inList(Item *symbol, Item *list)
 {
-    while (list->type != NULL_TYPE)
+    while (typeOf(list) != NULL_TYPE)
     {
-        if (strcmp(car(list)->s, symbol->s) == 0)
+        if (car(list) == symbol)
         {
             return true;
         }
@@ -87,388 +105,256 @@ bool inList(Item *symbol, Item *list)
     return false;
 }
 
-// Takes a pointer to Item type list of evaluated arguments and returns the summation of them as double if needed
-Item *p_plus(Item *args)
+// Takes an array of evaluated arguments and returns the summation of them as double if needed.
+// Integers are added exactly, becoming bignums when they overflow an int.
+Item *p_plus(int argc, Item **argv)
 {
-    // if args is empty, return 0
-    // while args
-
-    Item *sum = talloc(sizeof(Item));
-    sum->type = INT_TYPE;
-    sum->i = 0;
+    // if there are no arguments, return 0
+    Item *exact = makeInt(0);
+    bool inexact = false;
+    double sum = 0;
 
-    while (!isNull(args))
+    for (int i = 0; i < argc; i++)
     {
-        // sum is an int and next in args is int
-        Item *num = car(args);
-        if (sum->type == INT_TYPE && num->type == INT_TYPE)
-        {
-            sum->i = sum->i + num->i;
-        }
-
-        // sum is a double and next in args is int
-        else if (sum->type == DOUBLE_TYPE && num->type == INT_TYPE)
+        Item *num = argv[i];
+        if (isInteger(num) && !inexact)
         {
-            sum->d = sum->d + num->i;
+            exact = integerAdd(exact, num);
         }
-
-        // sum is int and next in args is double: when we convert to double type
-        else if (num->type == DOUBLE_TYPE && sum->type != DOUBLE_TYPE)
+        else if (isInteger(num))
         {
-            // convert
-            sum->type = DOUBLE_TYPE;
-            sum->d = sum->i + num->d;
+            sum = sum + integerToDouble(num);
         }
-        // sum is double and next in args is double
-        else if (num->type == DOUBLE_TYPE && sum->type == DOUBLE_TYPE)
+        else if (typeOf(num) == DOUBLE_TYPE)
         {
-            sum->d = sum->d + num->d;
+            // the sum becomes a double from the first double on
+            if (!inexact)
+            {
+                inexact = true;
+                sum = integerToDouble(exact);
+            }
+            sum = sum + num->d;
         }
         else
         {
             evaluationError("Adding non integer or double");
         }
-        args = cdr(args);
     }
-    return sum;
+    return inexact ? makeDouble(sum) : exact;
 }
 
-// Takes a pointer to two arguments and divides the first by second. eval error if if wrong number of arguments
-Item *p_div(Item *args)
+// Takes two arguments and divides the first by second. Integers that divide
+// exactly give an integer, and anything else a double.
+Item *p_div(int argc, Item **argv)
 {
-    // Ensure only two arguments are present
-    if (isNull(args) || isNull(cdr(args)) || !isNull(cdr(cdr(args))))
-    {
-        evaluationError("Division requires exactly two arguments");
-    }
-
-    Item *result = talloc(sizeof(Item));
-    Item *first = car(args);
-    Item *second = car(cdr(args));
+    Item *first = argv[0];
+    Item *second = argv[1];
 
     // Check types and perform division
-    if (first->type == INT_TYPE && second->type == INT_TYPE)
+    if (isInteger(first) && isInteger(second))
     {
-        if (second->i == 0)
+        Item *remainder;
+        Item *quotient = integerDivide(first, second, &remainder);
+        if (remainder == makeInt(0))
         {
-            evaluationError("Division by zero");
+            return quotient;
         }
         // Convert to double if not divisible evenly
-        if (first->i % second->i != 0)
-        {
-            result->type = DOUBLE_TYPE;
-            result->d = (double)first->i / second->i;
-        }
-        else
-        {
-            result->type = INT_TYPE;
-            result->i = first->i / second->i;
-        }
+        return makeDouble(integerToDouble(first) / integerToDouble(second));
     }
-    else if ((first->type == DOUBLE_TYPE || first->type == INT_TYPE) &&
-             (second->type == DOUBLE_TYPE || second->type == INT_TYPE))
+    if ((typeOf(first) == DOUBLE_TYPE || isInteger(first)) &&
+        (typeOf(second) == DOUBLE_TYPE || isInteger(second)))
     {
-        if ((second->type == INT_TYPE && second->i == 0) ||
-            (second->type == DOUBLE_TYPE && second->d == 0))
+        if (second == makeInt(0) || (typeOf(second) == DOUBLE_TYPE && second->d == 0))
         {
             evaluationError("Division by zero");
         }
-        result->type = DOUBLE_TYPE;
-        double firstVal = (first->type == INT_TYPE) ? (double)first->i : first->d;
-        double secondVal = (second->type == INT_TYPE) ? (double)second->i : second->d;
-        result->d = firstVal / secondVal;
-    }
-    else
-    {
-        evaluationError("Division with non-numeric types");
+        double firstVal = (typeOf(first) == DOUBLE_TYPE) ? first->d : integerToDouble(first);
+        double secondVal = (typeOf(second) == DOUBLE_TYPE) ? second->d : integerToDouble(second);
+        return makeDouble(firstVal / secondVal);
     }
-
-    return result;
+    evaluationError("Division with non-numeric types");
+    return NULL;
 }
 
-// Takes a pointer to arguments and multiplies the first by second ... eval error if if wrong number of arguments
-Item *p_mult(Item *args)
+// Takes an array of arguments and multiplies the first by second ...
+// Integers are multiplied exactly, becoming bignums when they overflow an int.
+Item *p_mult(int argc, Item **argv)
 {
-    Item *product = talloc(sizeof(Item));
-    product->type = INT_TYPE;
-    product->i = 1;
+    Item *exact = makeInt(1);
+    bool inexact = false;
+    double product = 1;
 
-    while (!isNull(args))
+    for (int i = 0; i < argc; i++)
     {
-        Item *num = car(args);
-        if (num->type == INT_TYPE)
+        Item *num = argv[i];
+        if (isInteger(num) && !inexact)
         {
-            if (product->type == INT_TYPE)
-            {
-                product->i *= num->i;
-            }
-            else
-            {
-                product->d *= num->i;
-            }
+            exact = integerMultiply(exact, num);
         }
-        else if (num->type == DOUBLE_TYPE)
+        else if (isInteger(num))
         {
-            if (product->type == INT_TYPE)
+            product *= integerToDouble(num);
+        }
+        else if (typeOf(num) == DOUBLE_TYPE)
+        {
+            if (!inexact)
             {
-                product->type = DOUBLE_TYPE;
-                product->d = product->i;
+                inexact = true;
+                product = integerToDouble(exact);
             }
-            product->d *= num->d;
+            product *= num->d;
         }
         else
         {
             evaluationError("Multiplication with non-numeric types");
         }
-        args = cdr(args);
     }
 
-    return product;
+    return inexact ? makeDouble(product) : exact;
 }
 
-// Takes a pointer to Item type list of evaluated arguments and returns first - second - .... as double if needed
-Item *p_minus(Item *args)
+// Takes an array of at least one evaluated argument and returns first - second - .... as double if needed.
+// Integers are subtracted exactly, becoming bignums when they overflow an int.
+Item *p_minus(int argc, Item **argv)
 {
-    // if args is empty, return 0
-    // while args
-
-    Item *sum = talloc(sizeof(Item));
-    if (!isNull(car(args)))
+    Item *first = argv[0];
+    Item *exact = first;
+    bool inexact = false;
+    double difference = 0;
+    if (typeOf(first) == DOUBLE_TYPE)
     {
-        copy_item(sum, car(args));
+        inexact = true;
+        difference = first->d;
     }
-    args = cdr(args);
-    while (!isNull(args))
+    else if (!isInteger(first))
     {
-        // sum is an int and next in args is int
-        Item *num = car(args);
-        if (sum->type == INT_TYPE && num->type == INT_TYPE)
-        {
-            sum->i = sum->i - num->i;
-        }
-
-        // sum is a double and next in args is int
-        else if (sum->type == DOUBLE_TYPE && num->type == INT_TYPE)
+        evaluationError("Adding non integer or double");
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        Item *num = argv[i];
+        if (isInteger(num) && !inexact)
         {
-            sum->d = sum->d - num->i;
+            exact = integerSubtract(exact, num);
         }
-
-        // sum is int and next in args is double: when we convert to double type
-        else if (num->type == DOUBLE_TYPE && sum->type != DOUBLE_TYPE)
+        else if (isInteger(num))
         {
-            // convert
-            sum->d = sum->i;
-            sum->type = DOUBLE_TYPE;
-            sum->d = sum->d - num->d;
+            difference = difference - integerToDouble(num);
         }
-        // sum is double and next in args is double
-        else if (num->type == DOUBLE_TYPE && sum->type == DOUBLE_TYPE)
+        else if (typeOf(num) == DOUBLE_TYPE)
         {
-            sum->d = sum->d - num->d;
+            // the difference becomes a double from the first double on
+            if (!inexact)
+            {
+                inexact = true;
+                difference = integerToDouble(exact);
+            }
+            difference = difference - num->d;
         }
         else
         {
             evaluationError("Adding non integer or double");
         }
-        args = cdr(args);
     }
-    return sum;
+    return inexact ? makeDouble(difference) : exact;
 }
 
-// Takes a pointer to two arguments of integer type and returns first modulo second with error checking
-Item *p_modulo(Item *args)
+// Takes two arguments of integer type and returns first modulo second with error checking
+Item *p_modulo(int argc, Item **argv)
 {
-    // if args is empty, return 0
-    // while args
-    if (isNull(car(args)) || isNull(car(cdr(args))) || !isNull(cdr(cdr(args))))
-    {
-        evaluationError("Incorrect format for modulo");
-    }
-    Item *mod = talloc(sizeof(Item));
+    Item *first = argv[0];
+    Item *second = argv[1];
 
-    Item *first = car(args);
-    Item *second = car(cdr(args));
-
-    if (first->type != INT_TYPE || second->type != INT_TYPE)
+    if (!isInteger(first) || !isInteger(second))
     {
         evaluationError("Not a number for modulo");
     }
-    mod->type = INT_TYPE;
-    mod->i = first->i % second->i;
-    return mod;
+    Item *remainder;
+    integerDivide(first, second, &remainder);
+    return remainder;
 }
 
 // takes in one argument and returns a bool_type item indicating whether it is a null item or not
-Item *p_null(Item *args)
+Item *p_null(int argc, Item **argv)
 {
-    // if args is empty or more than 1 argument -> eval error
-    if (isNull(args))
+    if (isNull(argv[0]) || (typeOf(argv[0]) == CONS_TYPE && isNull(car(argv[0]))))
     {
-        evaluationError("No arguments passed into null?");
-    }
-    Item *res = talloc(sizeof(Item));
-    if (cdr(args)->type != NULL_TYPE)
-    {
-        evaluationError("More than one argument passed into null?");
-    }
-
-    res->type = BOOL_TYPE;
-
-    if (isNull(car(args)) || (car(args)->type == CONS_TYPE && isNull(car(car(args)))))
-    {
-        res->s = "#t";
+        return TRUE_ITEM;
     }
     else
     {
-        res->s = "#f";
+        return FALSE_ITEM;
     }
-
-    return res;
 }
 
 // Takes in one argument that must be a cons type
 // returns the car of that cons cell
-Item *p_car(Item *args)
+Item *p_car(int argc, Item **argv)
 {
-    // if args is empty or more than 1 argument -> eval error
-    if (isNull(args))
-    {
-        evaluationError("No arguments passed into car");
-    }
-    if (cdr(args)->type != NULL_TYPE)
-    {
-        evaluationError("More than one argument passed into car");
-    }
-    if (car(args)->type != CONS_TYPE)
+    if (typeOf(argv[0]) != CONS_TYPE)
     {
         evaluationError("Is not a cons type");
     }
 
-    return (car(car(args)));
+    return car(argv[0]);
 }
 
 // Takes in one argument that must be a cons type
 // returns the cdr of that cons cell
-Item *p_cdr(Item *args)
+Item *p_cdr(int argc, Item **argv)
 {
-
-    if (isNull(args))
-    {
-        evaluationError("No arguments passed into cdr");
-    }
-
-    if (cdr(args)->type != NULL_TYPE)
-    {
-        evaluationError("More than one argument passed into cdr");
-    }
-    if (car(args)->type != CONS_TYPE)
+    if (typeOf(argv[0]) != CONS_TYPE)
     {
         evaluationError("Not a cons type");
     }
-    if (isNull(cdr(car(args))))
+    if (isNull(cdr(argv[0])))
     {
         return makeNull();
     }
 
-    return cdr(car(args));
+    return cdr(argv[0]);
 }
 
 // Takes in two args of any type and creates a new cons cell with its car being the first arg and cdr being the second arg
-Item *p_cons(Item *args)
-{
-    // printTree(args);
-    if (isNull(args))
-    {
-        evaluationError("No arguments passed into cons");
-    }
-    if (cdr(args)->type == NULL_TYPE)
-    {
-        evaluationError("One more argument needed for cons");
-    }
-    if (cdr(cdr(args))->type != NULL_TYPE)
-    {
-        evaluationError("More than two argument passed into cons");
-    }
-    return cons(car(args), (car(cdr(args))));
-}
-
-// (taken from linkedlist.c)
-// Takes two pointers to Items destination and source and copies the source to destination without pointing to source
-void copy_item(Item *destination, Item *source)
+Item *p_cons(int argc, Item **argv)
 {
-    switch (source->type)
-    {
-    case INT_TYPE:
-        destination->type = INT_TYPE;
-        destination->i = source->i;
-        break;
-    case DOUBLE_TYPE:
-        destination->type = DOUBLE_TYPE;
-        destination->d = source->d;
-        break;
-    case STR_TYPE:
-        destination->type = STR_TYPE;
-        destination->s = talloc(sizeof(source->s));
-        strcpy(destination->s, source->s);
-        break;
-    case CLOSURE_TYPE:
-        destination->type = CLOSURE_TYPE;
-        destination->cl = source->cl;
-    case CONS_TYPE:
-        destination->type = CONS_TYPE;
-        copy_item(destination->c.car, source->c.car);
-        copy_item(destination->c.cdr, source->c.cdr);
-    default:
-        break;
-    }
+    return cons(argv[0], argv[1]);
 }
 
 // Takes a pointer to item and returns a new copy of the item
+// Lists are copied a pair at a time along their cdrs, so only nesting uses the C stack.
+// Only the pairs are new: everything else is shared, since symbols are interned,
+// immediates are not allocated, and no other value can be changed in place
 Item *copy_list(Item *original_list)
 {
-
-    Item *new_list = makeNull();
-
-    if (original_list->type == CONS_TYPE)
-    {
-        new_list->type = CONS_TYPE;
-        new_list->c.car = copy_list(car(original_list));
-        new_list->c.cdr = copy_list(cdr(original_list));
-    }
-    else if (isNull(original_list))
-    {
-        return makeNull();
-    }
-    else
+    Item *new_list = NULL;
+    Item **tail = &new_list;
+    while (typeOf(original_list) == CONS_TYPE)
     {
-        copy_item(new_list, original_list);
+        Item *pair = gcItem();
+        pair->type = CONS_TYPE;
+        pair->c.car = copy_list(car(original_list));
+        *tail = pair;
+        tail = &pair->c.cdr;
+        original_list = cdr(original_list);
     }
+
+    *tail = original_list;
     return new_list;
 }
 
 // Takes two args, first one being a list and second being any type
 // makes a new copy of the first list and then tacks on the second arg
 // to the end of the new list
-Item *p_append(Item *args)
+Item *p_append(int argc, Item **argv)
 {
-    if (isNull(args))
-    {
-        evaluationError("No arguments passed into append");
-    }
-    if (cdr(args)->type == NULL_TYPE)
-    {
-        evaluationError("One more argument needed for append");
-    }
-    if (car(args)->type != CONS_TYPE)
+    if (typeOf(argv[0]) != CONS_TYPE)
     {
         evaluationError("Type should be cons");
     }
-    if (cdr(cdr(args))->type != NULL_TYPE)
-    {
-        evaluationError("More than 2 arguments to append");
-    }
 
-    Item *new_copy = copy_list(car(args));
+    Item *new_copy = copy_list(argv[0]);
 
     Item *head = makeNull();
     while (!isNull(new_copy))
@@ -476,7 +362,7 @@ Item *p_append(Item *args)
         head = cons(car(new_copy), head);
         new_copy = cdr(new_copy);
     }
-    Item *second = car(cdr(args));
+    Item *second = argv[1];
 
     if (isNull(car(head)))
     {
@@ -484,7 +370,7 @@ Item *p_append(Item *args)
         return second;
     }
 
-    if (second->type != CONS_TYPE)
+    if (typeOf(second) != CONS_TYPE)
     {
         head = reverse(head);
         Item *current = head;
@@ -506,72 +392,89 @@ Item *p_append(Item *args)
     return head;
 }
 
-// Takes two args, and returns true if first > second with error checking
-Item *p_l(Item *args)
+// Takes an item and returns true if it is an integer or a double
+static bool isNumber(Item *item)
+{
+    return isInteger(item) || typeOf(item) == DOUBLE_TYPE;
+}
+
+// Takes two numbers and returns a negative number, zero or a positive number
+// as the first is less than, equal to or greater than the second. Integers are
+// compared exactly, and anything else as doubles.
+static int compareNumbers(Item *first, Item *second)
 {
-    if (isNull(car(args)) || isNull(car(cdr(args))) || !isNull(cdr(cdr(args))))
+    if (isInteger(first) && isInteger(second))
     {
-        evaluationError("Incorrect format for <");
+        return integerCompare(first, second);
     }
+    double x = typeOf(first) == DOUBLE_TYPE ? first->d : integerToDouble(first);
+    double y = typeOf(second) == DOUBLE_TYPE ? second->d : integerToDouble(second);
+    return (x > y) - (x < y);
+}
 
-    Item *first = car(args);
-    Item *second = car(cdr(args));
+// Takes two args, and returns true if first > second with error checking
+Item *p_l(int argc, Item **argv)
+{
+    Item *first = argv[0];
+    Item *second = argv[1];
 
-    if ((first->type != INT_TYPE && first->type != DOUBLE_TYPE) || (second->type != INT_TYPE && second->type != DOUBLE_TYPE))
+    if (!isNumber(first) || !isNumber(second))
     {
         evaluationError("Not a number for <");
     }
-    Item *ret = talloc(sizeof(Item));
-    ret->type = BOOL_TYPE;
-    ret->s = talloc(2);
+    if (typeOf(first) == BIGNUM_TYPE || typeOf(second) == BIGNUM_TYPE)
+    {
+        return makeBool(compareNumbers(first, second) < 0);
+    }
+    Item *ret = FALSE_ITEM;
 
-    if (first->type == INT_TYPE)
+    if (typeOf(first) == INT_TYPE)
     {
-        if (second->type == INT_TYPE)
+        if (typeOf(second) == INT_TYPE)
         {
-            if (first->i < second->i)
+            if (intValue(first) < intValue(second))
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
-        if (second->type == DOUBLE_TYPE)
+        if (typeOf(second) == DOUBLE_TYPE)
         {
-            if (first->i < second->d)
+            if (intValue(first) < second->d)
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
     }
     else
     {
-        if (second->type == INT_TYPE)
+        if (typeOf(second) == INT_TYPE)
         {
-            if (first->d < second->i)
+            if (first->d < intValue(second))
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
-        if (second->type == DOUBLE_TYPE)
+        if (typeOf(second) == DOUBLE_TYPE)
         {
             if (first->d < second->d)
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
     }
@@ -579,207 +482,326 @@ Item *p_l(Item *args)
 }
 
 // Takes two args, and returns true if first < second with error checking
-Item *p_g(Item *args)
+Item *p_g(int argc, Item **argv)
 {
-    if (isNull(car(args)) || isNull(car(cdr(args))) || !isNull(cdr(cdr(args))))
-    {
-        evaluationError("Incorrect format for <");
-    }
-
-    Item *first = car(args);
-    Item *second = car(cdr(args));
+    Item *first = argv[0];
+    Item *second = argv[1];
 
-    if ((first->type != INT_TYPE && first->type != DOUBLE_TYPE) || (second->type != INT_TYPE && second->type != DOUBLE_TYPE))
+    if (!isNumber(first) || !isNumber(second))
     {
         evaluationError("Not a number for >");
     }
-    Item *ret = talloc(sizeof(Item));
-    ret->type = BOOL_TYPE;
-    ret->s = talloc(2);
+    if (typeOf(first) == BIGNUM_TYPE || typeOf(second) == BIGNUM_TYPE)
+    {
+        return makeBool(compareNumbers(first, second) > 0);
+    }
+    Item *ret = FALSE_ITEM;
 
-    if (first->type == INT_TYPE)
+    if (typeOf(first) == INT_TYPE)
     {
-        if (second->type == INT_TYPE)
+        if (typeOf(second) == INT_TYPE)
         {
-            if (first->i > second->i)
+            if (intValue(first) > intValue(second))
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
-        if (second->type == DOUBLE_TYPE)
+        if (typeOf(second) == DOUBLE_TYPE)
         {
-            if (first->i > second->d)
+            if (intValue(first) > second->d)
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
     }
     else
     {
-        if (second->type == INT_TYPE)
+        if (typeOf(second) == INT_TYPE)
         {
-            if (first->d > second->i)
+            if (first->d > intValue(second))
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
-        if (second->type == DOUBLE_TYPE)
+        if (typeOf(second) == DOUBLE_TYPE)
         {
             if (first->d > second->d)
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
     }
     return ret;
 }
 // Takes two args, and returns true if first == second with error checking
-Item *p_e(Item *args)
+Item *p_e(int argc, Item **argv)
 {
-    if (isNull(car(args)) || isNull(car(cdr(args))) || !isNull(cdr(cdr(args))))
-    {
-        evaluationError("Incorrect format for <");
-    }
-
-    Item *first = car(args);
-    Item *second = car(cdr(args));
+    Item *first = argv[0];
+    Item *second = argv[1];
 
-    if ((first->type != INT_TYPE && first->type != DOUBLE_TYPE) || (second->type != INT_TYPE && second->type != DOUBLE_TYPE))
+    if (!isNumber(first) || !isNumber(second))
     {
         evaluationError("Not a number for =");
     }
-    Item *ret = talloc(sizeof(Item));
-    ret->type = BOOL_TYPE;
-    ret->s = talloc(2);
+    if (typeOf(first) == BIGNUM_TYPE || typeOf(second) == BIGNUM_TYPE)
+    {
+        return makeBool(compareNumbers(first, second) == 0);
+    }
+    Item *ret = FALSE_ITEM;
 
-    if (first->type == INT_TYPE)
+    if (typeOf(first) == INT_TYPE)
     {
-        if (second->type == INT_TYPE)
+        if (typeOf(second) == INT_TYPE)
         {
-            if (first->i == second->i)
+            if (intValue(first) == intValue(second))
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
-        if (second->type == DOUBLE_TYPE)
+        if (typeOf(second) == DOUBLE_TYPE)
         {
-            if (first->i == second->d)
+            if (intValue(first) == second->d)
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
     }
     else
     {
-        if (second->type == INT_TYPE)
+        if (typeOf(second) == INT_TYPE)
         {
-            if (first->d == second->i)
+            if (first->d == intValue(second))
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
-        if (second->type == DOUBLE_TYPE)
+        if (typeOf(second) == DOUBLE_TYPE)
         {
             if (first->d == second->d)
             {
-                ret->s = "#t";
+                ret = TRUE_ITEM;
             }
             else
             {
-                ret->s = "#f";
+                ret = FALSE_ITEM;
             }
         }
     }
     return ret;
 }
 
+// The global frame's bindings are also indexed by an open-addressing hash
+// table from interned symbol to binding cell, so global lookups do not walk
+// top_frame->bindings. Global binding cells are permanent and never move, so
+// the collector never has to touch the table; the cells stay on
+// top_frame->bindings so that their values are still traced.
+#define GLOBAL_TABLE_SIZE 256
+
+Item **globalCells = NULL;
+size_t globalCapacity = 0;
+size_t globalCount = 0;
+
+// Takes a table and its capacity and returns the slot where the binding cell
+// of the given symbol either is or should go
+Item **globalSlot(Item **cells, size_t capacity, Item *symbol)
+{
+    size_t i = ((uintptr_t)symbol >> 3) * 2654435761u & (capacity - 1);
+    while (cells[i] != NULL && car(cells[i]) != symbol)
+    {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &cells[i];
+}
+
+// Takes an interned symbol and returns its global binding cell, or NULL if
+// the symbol is not globally bound
+Item *globalBinding(Item *symbol)
+{
+    if (globalCapacity == 0)
+    {
+        return NULL;
+    }
+    return *globalSlot(globalCells, globalCapacity, symbol);
+}
+
+// Moves every global binding cell into a table twice the size
+void growGlobals()
+{
+    size_t capacity = globalCapacity == 0 ? GLOBAL_TABLE_SIZE : globalCapacity * 2;
+    Item **cells = talloc(capacity * sizeof(Item *));
+    memset(cells, 0, capacity * sizeof(Item *));
+    for (size_t i = 0; i < globalCapacity; i++)
+    {
+        if (globalCells[i] != NULL)
+        {
+            *globalSlot(cells, capacity, car(globalCells[i])) = globalCells[i];
+        }
+    }
+    globalCells = cells;
+    globalCapacity = capacity;
+}
+
+// Takes an interned symbol and a value and binds the symbol to the value in
+// the global frame, overwriting any existing global binding in place
+void defineGlobal(Item *symbol, Item *value)
+{
+    Item *cell = globalBinding(symbol);
+    if (cell != NULL)
+    {
+        cell->c.cdr = value;
+        gcWriteBarrier(cell);
+        return;
+    }
+
+    if ((globalCount + 1) * 2 > globalCapacity)
+    {
+        growGlobals();
+    }
+    cell = gcPermanentItem();
+    cell->type = CONS_TYPE;
+    cell->c.car = symbol;
+    cell->c.cdr = value;
+    gcWriteBarrier(cell);
+    *globalSlot(globalCells, globalCapacity, symbol) = cell;
+    globalCount++;
+
+    top_frame->bindings = cons(cell, top_frame->bindings);
+    gcWriteBarrier(top_frame);
+}
+
 /*
  * Adds a binding between the given name
  * and the input function. Used to add
  * bindings for primitive funtions to the top-level
  * bindings list.
  */
-void bind(char *name, Item *(*function)(Item *), Frame *frame)
+void bind(char *name, Item *(*function)(int argc, Item **argv), int minArgs, int maxArgs, Frame *frame)
 {
     // Code omitted
-    Item *prim = talloc(sizeof(Item));
+    // primitives never move, so a call can hold on to one without rooting it
+    Item *prim = gcPermanentItem();
     prim->type = PRIMITIVE_TYPE;
-    prim->pf = function;
-    Item *cell = talloc(sizeof(Item));
-    Item *name_item = talloc(sizeof(Item));
-    name_item->type = STR_TYPE;
-    name_item->s = name;
-    cell->type = CONS_TYPE;
-    cell = cons(name_item, prim);
+    prim->prim.pf = function;
+    prim->prim.name = name;
+    prim->prim.minArgs = minArgs;
+    prim->prim.maxArgs = maxArgs;
+    if (frame == top_frame)
+    {
+        defineGlobal(intern(name), prim);
+        return;
+    }
+    Item *cell = cons(intern(name), prim);
     frame->bindings = cons(cell, frame->bindings);
 }
 
-// Takes a pointer to a parse tree and interprets it. Prints the result of execution if there is a result
-void interpret(Item *tree)
+// Takes a symbol and returns the operation of the primitive it is bound to
+// at the start of a run, or ARITHMETIC_NONE
+arithmeticOp arithmeticOperation(Item *symbol)
+{
+    static char *names[] = {NULL, "+", "-", "*", "<", ">", "="};
+    for (int op = ARITHMETIC_ADD; op <= ARITHMETIC_EQUAL; op++)
+    {
+        if (symbol == intern(names[op]))
+        {
+            return (arithmeticOp)op;
+        }
+    }
+    return ARITHMETIC_NONE;
+}
+
+// Interns the symbols the interpreter looks for outside of special form dispatch
+void internKeywords()
+{
+    elseSymbol = intern("else");
+}
+
+// Makes the global frame and binds the primitives in it
+static void makeGlobals()
 {
-    top_frame = talloc(sizeof(Frame));
-    top_frame->parent = NULL;
-    top_frame->bindings = makeNull();
+    internKeywords();
+
+    top_frame = makeFrame(NULL, makeNull(), 0);
+
+    // the global frame stays live for the whole run
+    gcPush(&top_frame);
 
     // make primitive function bindings
-    bind("+", p_plus, top_frame);
-    bind("-", p_minus, top_frame);
-    bind("null?", p_null, top_frame);
-    bind("car", p_car, top_frame);
-    bind("cdr", p_cdr, top_frame);
-    bind("cons", p_cons, top_frame);
-    bind("append", p_append, top_frame);
-    bind("<", p_l, top_frame);
-    bind(">", p_g, top_frame);
-    bind("=", p_e, top_frame);
-    bind("modulo", p_modulo, top_frame);
-    bind("/", p_div, top_frame);
-    bind("*", p_mult, top_frame);
+    // with the fewest and most arguments each takes, -1 for any number
+    bind("+", p_plus, 0, -1, top_frame);
+    bind("-", p_minus, 1, -1, top_frame);
+    bind("null?", p_null, 1, 1, top_frame);
+    bind("car", p_car, 1, 1, top_frame);
+    bind("cdr", p_cdr, 1, 1, top_frame);
+    bind("cons", p_cons, 2, 2, top_frame);
+    bind("append", p_append, 2, 2, top_frame);
+    bind("<", p_l, 2, 2, top_frame);
+    bind(">", p_g, 2, 2, top_frame);
+    bind("=", p_e, 2, 2, top_frame);
+    bind("modulo", p_modulo, 2, 2, top_frame);
+    bind("/", p_div, 2, 2, top_frame);
+    bind("*", p_mult, 0, -1, top_frame);
+    bind("call-with-current-continuation", p_callcc, 1, 1, top_frame);
+    bind("call/cc", p_callcc, 1, 1, top_frame);
+}
+
+// Takes a pointer to a parse tree and interprets it, with the bytecode VM if vm is set.
+// Prints the result of execution if there is a result. It can be called again
+// with more of the program, which sees everything the earlier calls defined.
+void interpret(Item *tree, bool vm)
+{
+    if (top_frame == NULL)
+    {
+        makeGlobals();
+    }
+
+    // the rest of the forms stay live until they have all been run
+    size_t roots = gcDepth();
+    gcPush(&tree);
 
     // int i =0;
-    while (tree->type != NULL_TYPE)
+    while (typeOf(tree) != NULL_TYPE)
     {
         // printTree(tree);
         // printf("---\n");
-        Item *result = eval(car(tree), top_frame); // eval car(tree) worked for lambdas
+        Item *result = vm ? vmEval(car(tree), top_frame) : eval(car(tree), top_frame); // eval car(tree) worked for lambdas
 
-        if (result && result->type != VOID_TYPE)
+        if (result && typeOf(result) != VOID_TYPE)
         {
-            if (result->type == CONS_TYPE)
+            if (typeOf(result) == CONS_TYPE)
             {
                 printf("(");
             }
             printTree(result);
 
-            if (result->type == CONS_TYPE)
+            if (typeOf(result) == CONS_TYPE)
             {
                 printf(")");
             }
@@ -787,6 +809,7 @@ void interpret(Item *tree)
         }
         tree = cdr(tree);
     }
+    gcPop(roots);
 }
 
 // takes a char* that specefies the type of evaluation error and frees the allocated memory before exiting
@@ -796,26 +819,31 @@ void evaluationError(char *error)
     texit(1);
 }
 
-// Takes an pointer to Item and a frame pointer and evaluates the clause of the if condition
-// returns an evaluation error if incorrect number of arguments is provided.
+// Takes an pointer to Item and a frame pointer and evaluates the condition of the if
+// returns the branch to evaluate next, which is in tail position
 Item *evalIf(Item *args, Frame *frame)
 {
+    size_t roots = gcDepth();
+    gcPush(&args);
 
     Item *result = eval(car(args), frame);
+    gcPop(roots);
 
-    if (!strcmp(result->s, "#f"))
+    if (result == FALSE_ITEM)
     {
-        return eval(car(cdr(cdr(args))), frame);
-    }
-    else
-    {
-        return eval(car(cdr(args)), frame);
+        return car(cdr(cdr(args)));
     }
+    return car(cdr(args));
 }
 
-// Takes an pointer to Item and a frame pointer and evaluates the clauses of the conditions and the appropriate body with error checking
+// Takes an pointer to Item and a frame pointer and evaluates the conditions of the clauses with error checking
+// returns the expression of the first true clause to evaluate next, which is in tail position
 Item *evalCond(Item *args, Frame *frame)
 {
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
+
     while (!isNull(args))
     {
         Item *currentPair = car(args);
@@ -826,12 +854,13 @@ Item *evalCond(Item *args, Frame *frame)
 
         Item *condition = car(currentPair);
 
-        if (!strcmp(condition->s, "else"))
+        if (condition == elseSymbol)
         {
             // If 'else' is present, evaluate the next expression in the pair
             if (!isNull(cdr(currentPair)))
             {
-                return eval(car(cdr(currentPair)), frame);
+                gcPop(roots);
+                return car(cdr(currentPair));
             }
             else
             {
@@ -841,58 +870,124 @@ Item *evalCond(Item *args, Frame *frame)
 
         Item *evaluatedCondition = eval(condition, frame);
 
-        if (evaluatedCondition->type != BOOL_TYPE)
-        {
-            evaluationError("Non-boolean condition in cond");
-        }
-
-        if (!strcmp(evaluatedCondition->s, "#t"))
+        // like if, anything other than #f counts as true
+        if (evaluatedCondition != FALSE_ITEM)
         {
+            // the pair may have moved while the condition was evaluated
+            currentPair = car(args);
+            Item *result;
             if (!isNull(cdr(currentPair)))
             {
-                return eval(car(cdr(currentPair)), frame);
+                result = car(cdr(currentPair));
             }
             else
             {
-                Item *voidItem = talloc(sizeof(Item));
-                voidItem->type = VOID_TYPE;
-                return voidItem;
+                result = VOID_ITEM;
             }
+            gcPop(roots);
+            return result;
         }
 
         args = cdr(args);
     }
 
-    Item *voidItem = talloc(sizeof(Item));
-    voidItem->type = VOID_TYPE;
-    return voidItem;
+    gcPop(roots);
+    return VOID_ITEM;
 }
 
-// Takes a string symbol and a pointer to a frame and returns the pointer to the frame containing the binding of the symbol with error checking
-Frame *getFrameWithSymbol(char *symbol, Frame *frame)
+// Takes a pointer to a parent frame, the list of names a new frame's slots are declared by and the
+// number of slots, and returns the new frame with every slot unassigned
+Frame *makeFrame(Frame *parent, Item *names, int size)
 {
-    if (frame == NULL)
+    Frame *frame = gcFrame(size);
+    frame->parent = parent;
+    frame->names = names;
+    frame->bindings = makeNull();
+    return frame;
+}
+
+// Takes a pointer to a frame and an interned symbol and returns the index of the slot it names, or -1
+// The names are either a lone symbol, a list of symbols or a list of (symbol value) bindings
+int getSlotIndex(Frame *frame, Item *symbol)
+{
+    Item *names = frame->names;
+    if (typeOf(names) == SYMBOL_TYPE)
     {
-        evaluationError("symbol not found: ");
-        texit(1);
+        return names == symbol ? 0 : -1;
+    }
+
+    for (int index = 0; index < frame->size; index++)
+    {
+        Item *name = car(names);
+        if (typeOf(name) == CONS_TYPE)
+        {
+            name = car(name);
+        }
+        if (name == symbol)
+        {
+            return index;
+        }
+        names = cdr(names);
+    }
+    return -1;
+}
+
+// Takes an interned symbol and a pointer to a frame and returns the address of the value the symbol is
+// bound to in that frame alone, or NULL if it is not bound there. Sets owner to the object holding it,
+// which is what the write barrier needs to see when the value is replaced.
+Item **getBindingInFrame(Item *symbol, Frame *frame, void **owner)
+{
+    if (frame == top_frame)
+    {
+        Item *cell = globalBinding(symbol);
+        if (cell == NULL)
+        {
+            return NULL;
+        }
+        *owner = cell;
+        return &cell->c.cdr;
+    }
+
+    int index = getSlotIndex(frame, symbol);
+    if (index >= 0)
+    {
+        *owner = frame;
+        return &frame->slots[index];
     }
 
     Item *current = frame->bindings;
-    while (current != NULL && current->type != NULL_TYPE)
+    while (!isNull(current))
     {
-        if (!strcmp(car(car(current))->s, symbol))
+        if (car(car(current)) == symbol)
         {
-            return frame;
+            *owner = car(current);
+            return &car(current)->c.cdr;
         }
         current = cdr(current);
     }
+    return NULL;
+}
+
+// Takes an interned symbol and a pointer to a frame and returns the pointer to the frame containing the binding of the symbol with error checking
+Frame *getFrameWithSymbol(Item *symbol, Frame *frame)
+{
+    if (frame == NULL)
+    {
+        evaluationError("symbol not found: ");
+    }
+
+    void *owner;
+    if (getBindingInFrame(symbol, frame, &owner) != NULL)
+    {
+        return frame;
+    }
     return getFrameWithSymbol(symbol, frame->parent);
 }
 
-// Takes a string symbol and a pointer to a frame and returns the pointer to the Item refereenced to by the symbol.
+// Takes an interned symbol and a pointer to a frame and returns the pointer to the Item refereenced to by the symbol.
 // Produces an evaluation error if the symbol isn't bound
 // recursively through parent frames until top-frame is reached
-Item *getsymbolfromframe(char *symbol, Frame *frame)
+Item *getsymbolfromframe(Item *symbol, Frame *frame)
 {
     if (frame == NULL)
     {
@@ -900,82 +995,192 @@ Item *getsymbolfromframe(char *symbol, Frame *frame)
         evaluationError("symbol not found: ");
     }
 
-    Item *current = frame->bindings;
-    while (current != NULL && current->type != NULL_TYPE)
+    void *owner;
+    Item **value = getBindingInFrame(symbol, frame, &owner);
+    if (value != NULL)
     {
-
-        if (!strcmp(car(car(current))->s, symbol))
+        if (*value == NULL)
         {
-            return cdr(car(current));
+            evaluationError("variable used before it was assigned");
         }
-        current = cdr(current);
+        return *value;
     }
 
     return getsymbolfromframe(symbol, frame->parent);
 }
 
-// Takes a pointer to a Item type of bindings and a pointer to Item type name and returns 1 if the same symbol name is already bound and false 0
-int isDuplicateBinding(Item *bindings, Item *name)
+// Takes a LOCAL_TYPE item and a pointer to a frame and returns the frame whose slot it refers to
+Frame *getLocalFrame(Item *local, Frame *frame)
 {
-    Item *list = bindings;
-
-    while (list->type != NULL_TYPE)
+    for (int depth = local->lr.depth; depth > 0; depth--)
     {
-        Item *nameToCheck = car(car(bindings));
-        if (!strcmp(name->s, nameToCheck->s))
-        {
-
-            return 1;
-        }
-        list = cdr(list);
+        frame = frame->parent;
     }
-    return 0;
+    return frame;
 }
 
-// Takes an pointer to Item type of arguments in the syle of ((x 3) (y 4)) and a pointer to a frame
-// Evaluates the bindings and returns the bindings list
-// produces an evaluation eror if incorrect symbol name or duplicate binding is provided
-Item *getbindings(Item *args, Frame *frame)
+// Takes a LOCAL_TYPE item and a pointer to a frame and returns the value in the slot it refers to
+// Produces an evaluation error if the slot has not been assigned yet, as in a letrec
+Item *getLocal(Item *local, Frame *frame)
 {
-    Item *ret = makeNull();
-    Item *linkedlist = args;
-
-    while (linkedlist->type != NULL_TYPE)
+    Item *value = getLocalFrame(local, frame)->slots[local->lr.index];
+    if (value == NULL)
     {
-        Item *name = car(car(linkedlist));
-        if (name->type != SYMBOL_TYPE)
-        {
-            evaluationError("Tyring to get value of non symbol");
-        }
+        evaluationError("variable used before it was assigned");
+    }
+    return value;
+}
 
-        // checks if the name for the next binding to be added has already been defined in the bindings list so far
-        if (isDuplicateBinding(ret, name))
+// Takes a GLOBAL_TYPE item and returns the global binding cell it refers to, looking it up the first time
+// Produces an evaluation error if the symbol isn't bound
+Item *getGlobalCell(Item *global)
+{
+    if (global->gr.cell == NULL)
+    {
+        global->gr.cell = globalBinding(global->gr.name);
+        if (global->gr.cell == NULL)
         {
-
-            evaluationError("duplicate binding");
+            evaluationError("symbol not found: ");
         }
+    }
+    return global->gr.cell;
+}
 
-        Item *cell = cons(name, eval(car(cdr(car(linkedlist))), frame));
+// Takes a symbol, LOCAL_TYPE or GLOBAL_TYPE item and a pointer to a frame and returns the value of the variable
+Item *lookupVariable(Item *variable, Frame *frame)
+{
+    if (typeOf(variable) == LOCAL_TYPE)
+    {
+        return getLocal(variable, frame);
+    }
+    if (typeOf(variable) == GLOBAL_TYPE)
+    {
+        return cdr(getGlobalCell(variable));
+    }
+    return getsymbolfromframe(variable, frame);
+}
+
+// Takes a symbol, LOCAL_TYPE or GLOBAL_TYPE item, a value and a pointer to a frame and assigns the value to the variable
+// Produces an evaluation error if the variable isn't bound
+void setVariable(Item *variable, Item *value, Frame *frame)
+{
+    if (typeOf(variable) == LOCAL_TYPE)
+    {
+        Frame *owner = getLocalFrame(variable, frame);
+        owner->slots[variable->lr.index] = value;
+        gcWriteBarrier(owner);
+        return;
+    }
+    if (typeOf(variable) == GLOBAL_TYPE)
+    {
+        Item *cell = getGlobalCell(variable);
+        cell->c.cdr = value;
+        gcWriteBarrier(cell);
+        return;
+    }
+
+    Frame *containingframe = getFrameWithSymbol(variable, frame);
+    void *owner;
+    Item **binding = getBindingInFrame(variable, containingframe, &owner);
+    *binding = value;
+    gcWriteBarrier(owner);
+}
+
+// Takes an interned symbol, a value and a pointer to a frame and binds the symbol to the value in that frame,
+// replacing any binding it already has there
+void defineVariable(Item *symbol, Item *value, Frame *frame)
+{
+    void *owner;
+    Item **binding = getBindingInFrame(symbol, frame, &owner);
+    if (frame == top_frame)
+    {
+        defineGlobal(symbol, value);
+    }
+    else if (binding != NULL)
+    {
+        *binding = value;
+        gcWriteBarrier(owner);
+    }
+    else
+    {
+        Item *cell = cons(symbol, value);
+        frame->bindings = cons(cell, frame->bindings);
+        gcWriteBarrier(frame);
+    }
+}
+
+// Takes a pointer to a Item type of bindings in the style of ((x 3) (y 4)) and a pointer to Item type name and returns 1 if the same symbol name is bound in it and false 0
+int isDuplicateBinding(Item *bindings, Item *name)
+{
+    Item *list = bindings;
+
+    while (typeOf(list) != NULL_TYPE)
+    {
+        Item *nameToCheck = car(car(list));
+        if (name == nameToCheck)
+        {
+
+            return 1;
+        }
+        list = cdr(list);
+    }
+    return 0;
+}
+
+// Takes an pointer to Item type of arguments in the syle of ((x 3) (y 4)), a pointer to the frame to evaluate them in
+// and a pointer to the new frame declared by them
+// Evaluates the bindings into the slots of the new frame
+// produces an evaluation eror if incorrect symbol name or duplicate binding is provided
+void getbindings(Item *args, Frame *frame, Frame *subframe)
+{
+    Item *linkedlist = args;
 
-        ret = cons(cell, ret);
+    size_t roots = gcDepth();
+    gcPush(&frame);
+    gcPush(&subframe);
+    gcPush(&linkedlist);
+
+    for (int index = 0; typeOf(linkedlist) != NULL_TYPE; index++)
+    {
+        Item *name = car(car(linkedlist));
+        if (typeOf(name) != SYMBOL_TYPE)
+        {
+            evaluationError("Tyring to get value of non symbol");
+        }
+
+        // checks if the name for the next binding is bound again later in the list
+        if (isDuplicateBinding(cdr(linkedlist), name))
+        {
+
+            evaluationError("duplicate binding");
+        }
+
+        Item *value = eval(car(cdr(car(linkedlist))), frame);
+        subframe->slots[index] = value;
+        gcWriteBarrier(subframe);
 
         linkedlist = cdr(linkedlist);
     }
 
-    return ret;
+    gcPop(roots);
 }
 
 // Takes a pointer to a body of expressions and a pointer to frame
-// evaluates the expressions in the body recursively and returns a pointer to item containing the result of last expression result
+// evaluates every expression in the body but the last and returns the last, which is in tail position
 Item *evalBody(Item *body, Frame *frame)
 {
-    while (cdr(body)->type != NULL_TYPE)
+    size_t roots = gcDepth();
+    gcPush(&body);
+    gcPush(&frame);
+
+    while (typeOf(cdr(body)) != NULL_TYPE)
     {
         eval(car(body), frame);
         body = cdr(body);
     }
 
-    return eval(car(body), frame);
+    gcPop(roots);
+    return car(body);
 }
 
 // Takes a pointer to arguments of set a pointer to frame and modifies the frame to reflect the change with error checking
@@ -989,102 +1194,107 @@ Item *evalSet(Item *args, Frame *frame)
     {
         evaluationError("incorrect n.o. arguments");
     }
-    // Item *olditem = getsymbolfromframe(car(args)->s, frame);
-    Frame *containingframe = getFrameWithSymbol(car(args)->s, frame);
-    Item *newitem = eval(car(cdr(args)), frame);
-
-    Item *current = containingframe->bindings;
-
-    while (!isNull(current))
+    // the variable must already be bound before its new value is evaluated
+    if (typeOf(car(args)) == SYMBOL_TYPE)
     {
-        if (!strcmp(car(car(current))->s, car(args)->s))
-        {
-            car(current)->c.cdr = newitem;
-            break;
-        }
-        current = cdr(current);
+        getFrameWithSymbol(car(args), frame);
+    }
+    else if (typeOf(car(args)) == GLOBAL_TYPE)
+    {
+        getGlobalCell(car(args));
     }
 
-    // copy_item(olditem, newitem);
-    Item *ret = talloc(sizeof(Item));
-    ret->type = VOID_TYPE;
-    return ret;
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
+    Item *newitem = eval(car(cdr(args)), frame);
+    gcPop(roots);
+
+    setVariable(car(args), newitem, frame);
+    return VOID_ITEM;
 }
 
-// Takes a pointer to arguments of set-car a pointer to frame and modifies the frame to reflect the change with error checking
+// Takes a pointer to arguments of set-car and a pointer to frame, evaluates the pair and the value, and sets the pair's car, with error checking
 Item *evalSetCar(Item *args, Frame *frame)
 {
-    if (frame == NULL)
-    {
-        evaluationError("No such variable");
-    }
     if (isNull(cdr(args)) || !isNull(cdr(cdr(args))))
     {
         evaluationError("incorrect n.o. arguments");
     }
 
-    Item *reference = getsymbolfromframe(car(args)->s, frame);
-    if (reference->type != CONS_TYPE)
+    // as in the VM, the pair can be any expression, and it is evaluated
+    // before the value
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
+    Item *reference = eval(car(args), frame);
+    gcPush(&reference);
+    Item *value = eval(car(cdr(args)), frame);
+    gcPop(roots);
+    if (typeOf(reference) != CONS_TYPE)
     {
         evaluationError("not cons type");
     }
-    *reference->c.car = *eval(car(cdr(args)), frame);
+    reference->c.car = value;
+    gcWriteBarrier(reference);
 
-    Item *ret = talloc(sizeof(Item));
-    ret->type = VOID_TYPE;
-    return ret;
+    return VOID_ITEM;
 }
 
-// Takes a pointer to arguments of set-cdr a pointer to frame and modifies the frame to reflect the change with error checking
+// Takes a pointer to arguments of set-cdr and a pointer to frame, evaluates the pair and the value, and sets the pair's cdr, with error checking
 Item *evalSetCdr(Item *args, Frame *frame)
 {
-    if (frame == NULL)
-    {
-        evaluationError("No such variable");
-    }
-
     if (isNull(cdr(args)) || !isNull(cdr(cdr(args))))
     {
         evaluationError("incorrect n.o. arguments");
     }
-    Item *reference = getsymbolfromframe(car(args)->s, frame);
 
-    if (reference->type != CONS_TYPE)
+    // evaluated the same way as set-car!
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
+    Item *reference = eval(car(args), frame);
+    gcPush(&reference);
+    Item *value = eval(car(cdr(args)), frame);
+    gcPop(roots);
+    if (typeOf(reference) != CONS_TYPE)
     {
         evaluationError("not cons type");
     }
-    *reference->c.cdr = *eval(car(cdr(args)), frame);
+    reference->c.cdr = value;
+    gcWriteBarrier(reference);
 
     // tfree(reference->c.cdr);
     // *reference->c.cdr = *eval(car(cdr(args)), frame);
-    Item *ret = talloc(sizeof(Item));
-    ret->type = VOID_TYPE;
-    return ret;
+    return VOID_ITEM;
 }
 
 // Takes an item pointer to arguments of a let expression and a pointer to a frame
-// Evaluates the bindings of the let expression and the returns a pointer to Item containing result of executing the body
+// Evaluates the bindings of the let expression and all of the body but the last expression, and returns the
+// last expression, which is in tail position. Sets bodyFrame to the frame to evaluate it in.
 // produces an evaluation error for incorrect synax or duplicate bindings
-Item *evalLet(Item *args, Frame *frame)
+Item *evalLet(Item *args, Frame *frame, Frame **bodyFrame)
 {
 
-    Frame *subframe = talloc(sizeof(Frame));
-    subframe->parent = frame;
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
 
-    if (car(args)->type != CONS_TYPE)
+    if (typeOf(car(args)) != CONS_TYPE)
     {
         evaluationError("Incorrect let format");
     }
 
+    Frame *subframe;
     if (isNull(car(car(args))) && isNull(cdr(car(args))))
     {
         // args does not have any bindings because its a cons type that points to two null types
-        subframe->bindings = makeNull();
+        subframe = makeFrame(frame, makeNull(), 0);
     }
     else
     {
 
-        if (car(car(args))->type != CONS_TYPE)
+        if (typeOf(car(car(args))) != CONS_TYPE)
         {
 
             evaluationError("Incorrect let body format");
@@ -1097,26 +1307,34 @@ Item *evalLet(Item *args, Frame *frame)
             evaluationError("args has a null binding");
         }
         // args has bindings to be gotten
-        subframe->bindings = getbindings(car(args), frame);
+        subframe = makeFrame(frame, car(args), length(car(args)));
+        gcPush(&subframe);
+        getbindings(car(args), frame, subframe);
     }
 
     if (isNull(cdr(args)))
     {
         evaluationError("no args following the bindings in let");
     }
-    subframe->bindings = reverse(subframe->bindings);
-    return evalBody(cdr(args), subframe);
+    gcPush(&subframe);
+    Item *last = evalBody(cdr(args), subframe);
+    *bodyFrame = subframe;
+    gcPop(roots);
+    return last;
 }
 
-// Takes an item pointer to arguments of a let* expression and a pointer to a frame and returns evaluated body with error checking
-Item *evalLetStar(Item *args, Frame *frame)
+// Takes an item pointer to arguments of a let* expression and a pointer to a frame with error checking
+// Returns the last expression of the body, which is in tail position, and sets bodyFrame to the frame to evaluate it in
+Item *evalLetStar(Item *args, Frame *frame, Frame **bodyFrame)
 {
 
-    Frame *subframe = talloc(sizeof(Frame));
-    subframe->parent = frame;
-    subframe->bindings = makeNull();
+    Frame *subframe = makeFrame(frame, makeNull(), 0);
 
-    if (car(args)->type != CONS_TYPE)
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&subframe);
+
+    if (typeOf(car(args)) != CONS_TYPE)
     {
         evaluationError("Incorrect let format");
     }
@@ -1124,12 +1342,11 @@ Item *evalLetStar(Item *args, Frame *frame)
     if (isNull(car(car(args))) && isNull(cdr(car(args))))
     {
         // args does not have any bindings because its a cons type that points to two null types
-        subframe->bindings = makeNull();
     }
     else
     {
 
-        if (car(car(args))->type != CONS_TYPE)
+        if (typeOf(car(car(args))) != CONS_TYPE)
         {
 
             evaluationError("Incorrect let body format");
@@ -1141,27 +1358,28 @@ Item *evalLetStar(Item *args, Frame *frame)
 
             evaluationError("args has a null binding");
         }
-        // args has bindings to be gotten
+        // args has bindings to be gotten, each in a frame of its own so later ones can shadow earlier ones
         Item *bindings = car(args);
+        gcPush(&bindings);
         while (!isNull(bindings))
         {
             Item *binding = car(bindings);
             Item *first = car(binding);
-            if (first->type != SYMBOL_TYPE)
+            if (typeOf(first) != SYMBOL_TYPE)
             {
                 evaluationError("Tyring to get value of non symbol");
             }
             Item *second = eval(car(cdr(binding)), subframe);
 
-            Item *cell = cons(first, second);
-            Frame *newSubframe = talloc(sizeof(Frame));
-            newSubframe->parent = subframe;
-            newSubframe->bindings = makeNull();
-            newSubframe->bindings = cons(cell, newSubframe->bindings);
+            Frame *newSubframe = makeFrame(subframe, bindings, 1);
+            newSubframe->slots[0] = second;
             subframe = newSubframe;
             bindings = cdr(bindings);
         }
-        return evalBody(cdr(args), subframe);
+        Item *last = evalBody(cdr(args), subframe);
+        *bodyFrame = subframe;
+        gcPop(roots);
+        return last;
     }
 
     if (isNull(cdr(args)))
@@ -1169,18 +1387,22 @@ Item *evalLetStar(Item *args, Frame *frame)
         evaluationError("no args following the bindings in let");
     }
 
-    return evalBody(cdr(args), subframe);
+    Item *last = evalBody(cdr(args), subframe);
+    *bodyFrame = subframe;
+    gcPop(roots);
+    return last;
 }
 
-// Takes an item pointer to arguments of a letrec expression and a pointer to a frame and returns evaluated body with error checking
-Item *evalLetRec(Item *args, Frame *frame)
+// Takes an item pointer to arguments of a letrec expression and a pointer to a frame with error checking
+// Returns the last expression of the body, which is in tail position, and sets bodyFrame to the frame to evaluate it in
+Item *evalLetRec(Item *args, Frame *frame, Frame **bodyFrame)
 {
 
-    Frame *subframe = talloc(sizeof(Frame));
-    subframe->parent = frame;
-    subframe->bindings = makeNull();
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
 
-    if (car(args)->type != CONS_TYPE)
+    if (typeOf(car(args)) != CONS_TYPE)
     {
         evaluationError("Incorrect let format");
     }
@@ -1189,15 +1411,16 @@ Item *evalLetRec(Item *args, Frame *frame)
         evaluationError("args following the bindings in let");
     }
 
+    Frame *subframe;
     if (isNull(car(car(args))) && isNull(cdr(car(args))))
     {
-        subframe->bindings = makeNull();
+        subframe = makeFrame(frame, makeNull(), 0);
     }
     // args does not have any bindings because its a cons type that points to two null types
     else
     {
 
-        if (car(car(args))->type != CONS_TYPE)
+        if (typeOf(car(car(args))) != CONS_TYPE)
         {
 
             evaluationError("Incorrect let body format");
@@ -1209,14 +1432,19 @@ Item *evalLetRec(Item *args, Frame *frame)
 
             evaluationError("args has a null binding");
         }
-        // args has bindings to be gotten
+        // args has bindings to be gotten. Every value is evaluated in the new frame, and they are only
+        // assigned to its slots once all of them have been evaluated.
+        subframe = makeFrame(frame, car(args), length(car(args)));
         Item *bindings = car(args);
         Item *evals = makeNull();
+        gcPush(&subframe);
+        gcPush(&bindings);
+        gcPush(&evals);
         while (!isNull(bindings))
         {
             Item *binding = car(bindings);
             Item *first = car(binding);
-            if (first->type != SYMBOL_TYPE)
+            if (typeOf(first) != SYMBOL_TYPE)
             {
                 evaluationError("Tyring to get value of non symbol");
             }
@@ -1224,22 +1452,19 @@ Item *evalLetRec(Item *args, Frame *frame)
             evals = cons(second, evals);
             bindings = cdr(bindings);
         }
-        bindings = car(args);
-        evals = reverse(evals);
 
-        while (!isNull(bindings))
+        for (int index = subframe->size - 1; index >= 0; index--)
         {
-            Item *binding = car(bindings);
-            Item *first = car(binding);
-            Item *second = car(evals);
-            Item *cell = cons(first, second);
-            subframe->bindings = cons(cell, subframe->bindings);
-            bindings = cdr(bindings);
+            subframe->slots[index] = car(evals);
             evals = cdr(evals);
         }
+        gcWriteBarrier(subframe);
     }
-    subframe->bindings = reverse(subframe->bindings);
-    return evalBody(cdr(args), subframe);
+    gcPush(&subframe);
+    Item *last = evalBody(cdr(args), subframe);
+    *bodyFrame = subframe;
+    gcPop(roots);
+    return last;
 }
 
 // Takes an item pointer to arguments of a define expression and a pointer to the frame
@@ -1261,102 +1486,267 @@ void evalDefine(Item *args, Frame *frame)
 
     Item *second = car(cdr(args));
 
-    if (first->type != SYMBOL_TYPE)
+    if (typeOf(first) != SYMBOL_TYPE)
 
     {
 
         evaluationError("incorrect define format");
     }
 
-    if (!strcmp(first->s, "lambda"))
+    if (formOf(first) == FORM_LAMBDA)
 
     {
 
         //
     }
 
-    if (isDuplicateBinding(frame->bindings, first))
-
-    {
-
-        Item *current = frame->bindings;
-
-        while (current->type != NULL_TYPE)
-
-        {
-
-            if (!strcmp(car(car(current))->s, first->s))
-
-            {
-
-                cdr(car(current))->c.car = eval(second, frame);
-
-                return;
-            }
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
+    Item *value = eval(second, frame);
+    gcPop(roots);
+    defineVariable(car(args), value, frame);
+}
 
-            current = cdr(current);
-        }
-    }
+// A closure application in tail position is not made by the C function that reaches it. The closure and its
+// arguments are left here instead, and TAIL_CALL is handed back up to the applyLambda loop, which makes the
+// call in place of the one that just finished. Nothing can be allocated on the way back up, so they need no
+// rooting.
+Item tailCallMarker;
+Item *pendingClosure;
+Item *pendingArgs;
+
+// Takes a pointer to an item of type closure and its arguments and returns TAIL_CALL, for the call to be made
+// by the nearest applyLambda or eval
+Item *tailCall(Item *closure, Item *args)
+{
+    pendingClosure = closure;
+    pendingArgs = args;
+    return TAIL_CALL;
+}
 
-    else
+// A call to applyLambda made on a new segment of stack, with the arguments it
+// was made with and the value it returned
+typedef struct DeferredCall
+{
+    Item *closure;
+    Item *args;
+    Item *result;
+} DeferredCall;
 
-    {
-        Item *binding = cons(first, eval(second, frame));
-        frame->bindings = cons(binding, frame->bindings);
-    }
+// Takes a DeferredCall and makes the call it holds
+static void applyOnNewSegment(void *argument)
+{
+    DeferredCall *call = argument;
+    call->result = applyLambda(call->closure, call->args);
 }
 
 // Takes a pointer to a item of type closure and arguments
 // Sets the parameter names to the arguments
 // Evaluates the lambda function and returns the result in a pointer to Item
+// Tail calls made by the body are made here in turn, so they take no C stack,
+// and the call moves to a new segment of stack if this one is nearly used up
 // Produces an evaluation error on incorrect number of arguments or incorrect syntax
 Item *applyLambda(Item *closure, Item *args)
 {
+    if (stackNearlyFull())
+    {
+        DeferredCall call = {closure, args, NULL};
+        stackRunOnNewSegment(applyOnNewSegment, &call);
+        return call.result;
+    }
 
-    Frame *evalframe = talloc(sizeof(Frame));
-    evalframe->bindings = makeNull();
-    evalframe->parent = closure->cl.frame;
-    Item *body = closure->cl.functionCode;
-    if (closure->cl.paramNames->type == NULL_TYPE)
+    while (true)
     {
-        if (!isNull(args))
+        Item *params = closure->cl.paramNames;
+        Frame *evalframe;
+        if (typeOf(params) == SYMBOL_TYPE)
         {
-            evaluationError("Should't take args");
+            // (lambda args ...) gets all of its arguments as one list
+            evalframe = makeFrame(closure->cl.frame, params, 1);
+            evalframe->slots[0] = args;
         }
-        // no params
-    }
-    else if (closure->cl.paramNames->type == CONS_TYPE)
-    {
-        // (x y z)
-        Item *current = closure->cl.paramNames;
-
-        while (args->type != NULL_TYPE && current->type != NULL_TYPE)
+        else
         {
-            if (args->type == NULL_TYPE)
+            // (x y z)
+            evalframe = makeFrame(closure->cl.frame, params, length(params));
+            for (int index = 0; index < evalframe->size; index++)
             {
-                evaluationError("args don't match with procedure");
+                if (typeOf(args) == NULL_TYPE)
+                {
+                    evaluationError("number of actual parameters does not equal number of formal parameters");
+                }
+                evalframe->slots[index] = car(args);
+                args = cdr(args);
             }
 
-            Item *cell = cons(car(current), car(args));
+            if (typeOf(args) != NULL_TYPE)
+            {
+                evaluationError("number of actual parameters does not equal number of formal parameters");
+            }
+        }
 
-            evalframe->bindings = cons(cell, evalframe->bindings);
-            current = cdr(current);
-            args = cdr(args);
+        Item *result = runAnalyzed(closure->cl.functionCode, evalframe);
+        if (result != TAIL_CALL)
+        {
+            return result;
         }
+        closure = pendingClosure;
+        args = pendingArgs;
+    }
+}
+
+// Arguments to primitives are evaluated onto this stack rather than into a
+// list, and handed over as a slice of it. It is a root for the rest of the run.
+static Item **argStack = NULL;
+static size_t argCount = 0;
+static size_t argCapacity = 0;
+
+// Returns the number of arguments on the argument stack, to be handed to
+// applyPrimitive once a call's arguments have been pushed
+size_t argumentCount()
+{
+    return argCount;
+}
 
-        if (args->type != NULL_TYPE && current->type == NULL_TYPE)
+// Takes an evaluated argument and pushes it on the argument stack
+void pushArgument(Item *argument)
+{
+    if (argCount == argCapacity)
+    {
+        if (argStack == NULL)
+        {
+            gcAddRoots((void ***)&argStack, &argCount);
+        }
+        // the old stack is simply left behind in the arena
+        size_t grown = argCapacity == 0 ? 256 : argCapacity * 2;
+        Item **copy = talloc(grown * sizeof(Item *));
+        if (argCount > 0)
         {
-            evaluationError("number of actual parameters does not equal number of formal parameters");
+            memcpy(copy, argStack, argCount * sizeof(Item *));
         }
+        argStack = copy;
+        argCapacity = grown;
     }
-    else
+    argStack[argCount++] = argument;
+}
+
+// Takes a primitive and the argument count from before its arguments were
+// pushed, calls it with them, pops them and returns its result
+Item *applyPrimitive(Item *primitive, size_t base)
+{
+    Item *result = callPrimitive(primitive, (int)(argCount - base), &argStack[base]);
+    argCount = base;
+    return result;
+}
+
+// Takes a primitive that was called with the wrong number of arguments and
+// produces an evaluation error naming it
+void arityError(Item *primitive)
+{
+    char message[128];
+    snprintf(message, sizeof(message), "Wrong number of arguments passed into %s", primitive->prim.name);
+    evaluationError(message);
+}
+
+// A call to call/cc that has not returned yet, kept on the C stack of the call.
+// They are chained innermost first, so escaping to one can retire every one
+// inside it.
+typedef struct Escape
+{
+    jmp_buf target;
+    Item *continuation;
+    struct Escape *outer;
+} Escape;
+
+static Escape *escapes = NULL;
+
+// The value being handed to the continuation that is being escaped to
+static Item *escapeValue = NULL;
+
+// Takes a continuation and the arguments it was called with, and returns the
+// argument from the call/cc that made the continuation, abandoning everything
+// evaluated since. Continuations made by the evaluator can only escape:
+// produces an evaluation error if that call/cc has already returned. Calling
+// a continuation again after that, as generators do, is left to the VM,
+// which keeps its call stack in the heap and so can copy it cheaply.
+Item *applyContinuation(Item *continuation, Item *args)
+{
+    if (typeOf(args) != CONS_TYPE || !isNull(cdr(args)))
+    {
+        evaluationError("continuation takes exactly one argument");
+    }
+    Escape *escape = continuation->k.state;
+    if (escape == NULL)
     {
+        evaluationError("continuation called after its call/cc returned (run with --vm to re-enter continuations)");
+    }
 
-        Item *cell = cons(closure->cl.paramNames, args);
-        evalframe->bindings = cons(cell, evalframe->bindings);
+    // the target and every call/cc inside it return here and now
+    while (escapes != escape)
+    {
+        escapes->continuation->k.state = NULL;
+        escapes = escapes->outer;
     }
-    evalframe->bindings = reverse(evalframe->bindings);
-    return evalBody(body, evalframe);
+    escape->continuation->k.state = NULL;
+    escapes = escape->outer;
+
+    escapeValue = car(args);
+    longjmp(escape->target, 1);
+}
+
+// Takes an array holding a procedure and calls it with the current
+// continuation. Returns what the procedure returns, or the value the
+// continuation is called with if that happens first. Neither the C stack nor
+// anything else is copied, so escaping costs no more than returning.
+Item *p_callcc(int argc, Item **argv)
+{
+    // argv is only good until the receiver starts evaluating
+    Item *receiver = argv[0];
+    size_t arguments = argumentCount();
+
+    Escape escape;
+    escape.continuation = gcItem();
+    escape.continuation->type = CONTINUATION_TYPE;
+    escape.continuation->k.state = &escape;
+    escape.outer = escapes;
+
+    size_t roots = gcDepth();
+    size_t segments = stackSegmentDepth();
+    gcPush(&escape.continuation);
+    if (setjmp(escape.target) != 0)
+    {
+        // applyContinuation has already retired this call
+        gcPop(roots);
+        stackUnwind(segments);
+        argCount = arguments;
+        Item *value = escapeValue;
+        escapeValue = NULL;
+        return value;
+    }
+    escapes = &escape;
+
+    Item *result;
+    Item *receiverArgs = cons(escape.continuation, makeNull());
+    switch (typeOf(receiver))
+    {
+    case CLOSURE_TYPE:
+        result = applyLambda(receiver, receiverArgs);
+        break;
+    case PRIMITIVE_TYPE:
+        result = callPrimitive(receiver, 1, &escape.continuation);
+        break;
+    case CONTINUATION_TYPE:
+        result = applyContinuation(receiver, receiverArgs);
+        break;
+    default:
+        evaluationError("call/cc takes a procedure");
+    }
+
+    escape.continuation->k.state = NULL;
+    escapes = escape.outer;
+    gcPop(roots);
+    return result;
 }
 
 // Takes a pointer to the args and the pointer to the corresponding frame
@@ -1375,53 +1765,83 @@ Item *evaluateArgs(Item *args, Frame *frame)
     else
     {
         // (x y z) type
+        // the list is built in order, each argument going on the end of it
+        Item *last = NULL;
+        size_t roots = gcDepth();
+        gcPush(&args);
+        gcPush(&frame);
+        gcPush(&evaluated_args);
+        gcPush(&last);
         while (!isNull(args))
         {
             Item *arg = eval(car(args), frame);
-            evaluated_args = cons(arg, evaluated_args);
+            Item *pair = cons(arg, makeNull());
+            if (last == NULL)
+            {
+                evaluated_args = pair;
+            }
+            else
+            {
+                last->c.cdr = pair;
+                gcWriteBarrier(last);
+            }
+            last = pair;
             args = cdr(args);
         }
-        evaluated_args = reverse(evaluated_args);
+        gcPop(roots);
         return evaluated_args;
     }
 }
 
 // Takes a lambda expression and creates a closure type item with the parameter names, frame, and code
+// The first time a lambda expression is seen its body is analysed, and the analysed body replaces
+// the body in the parse tree so the lambda is only ever analysed once
 // produces an evaluation error on incorrect syntax
 // returns an pointer to the closure type item containing the lambda expression
 Item *makeLambda(Item *args, Frame *frame)
 {
 
-    Item *c = talloc(sizeof(Item));
+    Item *c = gcItem();
     c->type = CLOSURE_TYPE;
     c->cl.frame = frame;
-    c->cl.functionCode = cdr(args);
-    if (cdr(args)->type == NULL_TYPE)
+    if (typeOf(cdr(args)) == NULL_TYPE)
     {
         evaluationError("No code");
     }
+    if (typeOf(cdr(args)) == PTR_TYPE)
+    {
+        c->cl.paramNames = analyzedParams(cdr(args));
+        c->cl.functionCode = cdr(args);
+        return c;
+    }
     c->cl.paramNames = makeNull();
 
-    if (args->type == NULL_TYPE)
+    if (typeOf(args) == NULL_TYPE)
     {
         // no args
     }
-    else if (car(args)->type == CONS_TYPE)
+    else if (typeOf(car(args)) == CONS_TYPE)
     {
         // x y az
         Item *current = car(args);
-        while (current->type != NULL_TYPE)
+        while (typeOf(current) != NULL_TYPE)
         {
 
-            if (car(current)->type != SYMBOL_TYPE && car(current)->type != NULL_TYPE)
+            if (typeOf(car(current)) != SYMBOL_TYPE && typeOf(car(current)) != NULL_TYPE)
             {
                 evaluationError("Must be symbol");
             }
+            if (typeOf(car(current)) == NULL_TYPE)
+            {
+                // an empty parameter list parses as a list holding ()
+                current = cdr(current);
+                continue;
+            }
             if (inList(car(current), c->cl.paramNames))
             {
                 evaluationError("Duplicate symbol");
             }
-            if (car(current)->type == CONS_TYPE)
+            if (typeOf(car(current)) == CONS_TYPE)
             {
                 evaluationError("lol how");
             }
@@ -1431,11 +1851,15 @@ Item *makeLambda(Item *args, Frame *frame)
         }
         c->cl.paramNames = reverse(c->cl.paramNames);
     }
-    else if (car(args)->type == SYMBOL_TYPE)
+    else if (typeOf(car(args)) == SYMBOL_TYPE)
     {
 
         c->cl.paramNames = car(args);
     }
+
+    args->c.cdr = analyzeLambda(c->cl.paramNames, cdr(args));
+    gcWriteBarrier(args);
+    c->cl.functionCode = cdr(args);
     return c;
 }
 
@@ -1444,270 +1868,330 @@ Item *evalAnd(Item *args, Frame *frame)
 {
 
     Item *clause = car(args);
-    Item *ret = talloc(sizeof(Item));
-    ret->type = BOOL_TYPE;
-    ret->s = talloc(2);
-
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
     while (!isNull(args))
     {
         Item *clause = car(args);
 
         Item *result = eval(clause, frame);
-        if (result->type == BOOL_TYPE)
+        if (result == FALSE_ITEM)
         {
-            if (result->s[1] == 'f')
-            {
-                ret->s = "#f";
-                return ret;
-            }
+            gcPop(roots);
+            return FALSE_ITEM;
         }
         args = cdr(args);
     }
-    ret->s = "#t";
-    return ret;
+    gcPop(roots);
+    return TRUE_ITEM;
 }
 
-// Takes an item pointer to arguments of and expression and a frame and returns false if all clauses are false false otherswise
+// Takes an item pointer to arguments of and expression and a frame and returns false if all clauses are false true otherswise
 Item *evalOr(Item *args, Frame *frame)
 {
 
     Item *clause = car(args);
-    Item *ret = talloc(sizeof(Item));
-    ret->type = BOOL_TYPE;
-    ret->s = talloc(2);
-
+    size_t roots = gcDepth();
+    gcPush(&args);
+    gcPush(&frame);
     while (!isNull(args))
     {
         Item *clause = car(args);
 
         Item *result = eval(clause, frame);
-        if (result->type == BOOL_TYPE)
+        if (result != FALSE_ITEM)
         {
-            if (result->s[1] == 't')
-            {
-                ret->s = "#t";
-                return ret;
-            }
+            gcPop(roots);
+            return TRUE_ITEM;
         }
         args = cdr(args);
     }
-    ret->s = "#f";
-    return ret;
+    gcPop(roots);
+    return FALSE_ITEM;
 }
 
-// Takes a pointer to a parse tree item type and a pointer to a frame
-// evaluates the parse tree within the frame and returns the result of evaluation
-Item *eval(Item *tree, Frame *frame)
+// Takes the arguments of a call whose procedure turned out not to be a
+// procedure and the frame of the call, evaluates the arguments, as the
+// analyser and the VM do before they find out, and produces an evaluation error
+static void notAProcedure(Item *args, Frame *frame)
 {
+    evaluateArgs(args, frame);
+    evaluationError("not a procedure");
+}
 
-    switch (tree->type)
-    {
-    case INT_TYPE:
-    {
-        return tree;
-    }
-    case DOUBLE_TYPE:
-    {
-        return tree;
-    }
-    case SYMBOL_TYPE:
-    {
-        return getsymbolfromframe(tree->s, frame);
-    }
-    case BOOL_TYPE:
-    {
-        return tree;
-    }
-    case STR_TYPE:
-    {
-        return tree;
-    }
-    case CLOSURE_TYPE:
+// Takes a pointer to a parse tree item type and a pointer to a frame
+// evaluates the parse tree within the frame and returns the result of evaluation, or TAIL_CALL if that is
+// a closure application still to be made
+// The expressions in tail position of if, cond, let, let* and letrec are evaluated by going round the loop
+// again rather than by calling eval, so they take no C stack
+Item *evalTail(Item *tree, Frame *frame)
+{
+    // integers, booleans and the other constants evaluate to themselves
+    if (isImmediate(tree))
     {
         return tree;
     }
-    case CONS_TYPE:
+
+    size_t roots = gcDepth();
+    gcPush(&tree);
+    gcPush(&frame);
+
+    Item *result = 0;
+    while (true)
     {
-        Item *first = car(tree);
-        Item *args = cdr(tree);
-        if (first->type == CLOSURE_TYPE)
+        if (isImmediate(tree))
         {
-            return applyLambda(first, evaluateArgs(args, frame));
+            result = tree;
+            break;
         }
+        gcSafepoint();
 
-        if (first->type == PRIMITIVE_TYPE)
+        switch (typeOf(tree))
         {
-            // Item *evaluatedArgs = evaluateArgs(args, frame); // Evaluate arguments in the current frame
-
-            // Frame *newframe = talloc(sizeof(Frame));
-            // newframe->parent = frame;
-            // newframe->bindings = makeNull();
-
-            // while (!isNull(args) && !isNull(evaluatedArgs))
-            // {
-            //     if (car(args)->type == SYMBOL_TYPE)
-            //     {
-            //         Item *binding = cons(car(args), car(evaluatedArgs));
-            //         newframe->bindings = cons(binding, newframe->bindings);
-            //     }
-            //     evaluatedArgs = cdr(evaluatedArgs); // Move to the next evaluated argument
-            // }
-
-            return first->pf(evaluateArgs(args, frame));
+        case INT_TYPE:
+        {
+            result = tree;
+            break;
         }
-
-        if (first->type == SYMBOL_TYPE)
+        case DOUBLE_TYPE:
+        case BIGNUM_TYPE:
         {
-            if (!strcmp(first->s, "if"))
-            {
-                if (args->type == NULL_TYPE || cdr(args)->type == NULL_TYPE)
-                {
-                    evaluationError("incorrect if format");
-                }
-
-                return evalIf(args, frame); // Helper functions can make your code easier to navigate!
-            }
-            else if (!strcmp(first->s, "let"))
-            {
-                return evalLet(args, frame);
-            }
-            else if (!strcmp(first->s, "display"))
-            {
-                printTree(eval(car(args), frame));
-                Item *x = makeNull();
-                x->type = VOID_TYPE;
-                return x;
-            }
-            else if (!strcmp(first->s, "newline"))
+            result = tree;
+            break;
+        }
+        case SYMBOL_TYPE:
+        {
+            result = getsymbolfromframe(tree, frame);
+            break;
+        }
+        case LOCAL_TYPE:
+        {
+            result = getLocal(tree, frame);
+            break;
+        }
+        case GLOBAL_TYPE:
+        {
+            result = cdr(getGlobalCell(tree));
+            break;
+        }
+        case BOOL_TYPE:
+        {
+            result = tree;
+            break;
+        }
+        case STR_TYPE:
+        {
+            result = tree;
+            break;
+        }
+        case CLOSURE_TYPE:
+        {
+            result = tree;
+            break;
+        }
+        case CONS_TYPE:
+        {
+            Item *first = car(tree);
+            Item *args = cdr(tree);
+            if (typeOf(first) == CLOSURE_TYPE)
             {
-                printf("\n");
-                Item *x = makeNull();
-                x->type = VOID_TYPE;
-                return x;
+                Item *evaluatedArgs = evaluateArgs(args, frame);
+                result = tailCall(car(tree), evaluatedArgs);
             }
-            else if (!strcmp(first->s, "let*"))
+
+            else if (typeOf(first) == PRIMITIVE_TYPE)
             {
-                return evalLetStar(args, frame);
+                // the procedure stays in tree, which is rooted
+                size_t base = argumentCount();
+                gcPush(&args);
+                while (!isNull(args))
+                {
+                    pushArgument(eval(car(args), frame));
+                    args = cdr(args);
+                }
+                result = applyPrimitive(car(tree), base);
             }
-            else if (!strcmp(first->s, "letrec"))
+
+            else if (typeOf(first) == CONTINUATION_TYPE)
             {
-                return evalLetRec(args, frame);
+                Item *evaluatedArgs = evaluateArgs(args, frame);
+                result = applyContinuation(car(tree), evaluatedArgs);
             }
-            else if (!strcmp(first->s, "quote"))
+
+            else if (typeOf(first) == SYMBOL_TYPE)
             {
-                if (args->type == NULL_TYPE || cdr(args)->type != NULL_TYPE)
+                switch (first->sym.form)
                 {
-
-                    evaluationError("incorrect quote format");
+                case FORM_IF:
+                {
+                    if (typeOf(args) == NULL_TYPE || typeOf(cdr(args)) == NULL_TYPE)
+                    {
+                        evaluationError("incorrect if format");
+                    }
+                    tree = evalIf(args, frame); // Helper functions can make your code easier to navigate!
+                    continue;
                 }
-                // printTree(args);
-                // print_type(args);
-
-                return car(args);
-            }
-            else if (!strcmp(first->s, "define"))
-            {
-                if (isNull(args))
+                case FORM_LET:
                 {
-                    evaluationError("Incorrect form");
+                    tree = evalLet(args, frame, &frame);
+                    continue;
                 }
-                Item *v = talloc(sizeof(Item));
-                v->type = VOID_TYPE;
-                evalDefine(args, frame);
-                return v;
-            }
-            else if (!strcmp(first->s, "lambda"))
-            {
-                if (isNull(args))
+                case FORM_DISPLAY:
                 {
-                    evaluationError("incorrect format");
+                    printTree(eval(car(args), frame));
+                    result = VOID_ITEM;
+                    break;
                 }
-                return makeLambda(args, frame);
-            }
-            else if (!strcmp(first->s, "set!"))
-            {
-                if (isNull(args))
+                case FORM_NEWLINE:
                 {
-                    evaluationError("incorrect format set");
+                    printf("\n");
+                    result = VOID_ITEM;
+                    break;
                 }
-
-                return evalSet(args, frame);
-            }
-            else if (!strcmp(first->s, "set-car!"))
-            {
-                if (isNull(args))
+                case FORM_LET_STAR:
                 {
-                    evaluationError("incorrect format set");
+                    tree = evalLetStar(args, frame, &frame);
+                    continue;
                 }
-
-                return evalSetCar(args, frame);
-            }
-            else if (!strcmp(first->s, "set-cdr!"))
-            {
-                if (isNull(args))
+                case FORM_LETREC:
                 {
-                    evaluationError("incorrect format set");
+                    tree = evalLetRec(args, frame, &frame);
+                    continue;
                 }
-
-                return evalSetCdr(args, frame);
-            }
-            else if (!strcmp(first->s, "and"))
-            {
-                if (isNull(args))
+                case FORM_QUOTE:
                 {
-                    evaluationError("incorrect format and");
+                    if (typeOf(args) == NULL_TYPE || typeOf(cdr(args)) != NULL_TYPE)
+                    {
+                        evaluationError("incorrect quote format");
+                    }
+                    result = car(args);
+                    break;
                 }
-
-                return evalAnd(args, frame);
-            }
-            else if (!strcmp(first->s, "or"))
-            {
-                if (isNull(args))
+                case FORM_DEFINE:
+                {
+                    if (isNull(args))
+                    {
+                        evaluationError("Incorrect form");
+                    }
+                    evalDefine(args, frame);
+                    result = VOID_ITEM;
+                    break;
+                }
+                case FORM_LAMBDA:
+                {
+                    if (isNull(args))
+                    {
+                        evaluationError("incorrect format");
+                    }
+                    result = makeLambda(args, frame);
+                    break;
+                }
+                case FORM_SET:
+                {
+                    if (isNull(args))
+                    {
+                        evaluationError("incorrect format set");
+                    }
+                    result = evalSet(args, frame);
+                    break;
+                }
+                case FORM_SET_CAR:
+                {
+                    if (isNull(args))
+                    {
+                        evaluationError("incorrect format set");
+                    }
+                    result = evalSetCar(args, frame);
+                    break;
+                }
+                case FORM_SET_CDR:
                 {
-                    evaluationError("incorrect format or");
+                    if (isNull(args))
+                    {
+                        evaluationError("incorrect format set");
+                    }
+                    result = evalSetCdr(args, frame);
+                    break;
+                }
+                case FORM_AND:
+                {
+                    if (isNull(args))
+                    {
+                        evaluationError("incorrect format and");
+                    }
+                    result = evalAnd(args, frame);
+                    break;
+                }
+                case FORM_OR:
+                {
+                    if (isNull(args))
+                    {
+                        evaluationError("incorrect format or");
+                    }
+                    result = evalOr(args, frame);
+                    break;
+                }
+                case FORM_COND:
+                {
+                    if (typeOf(args) == NULL_TYPE || typeOf(cdr(args)) == NULL_TYPE)
+                    {
+                        evaluationError("incorrect cond format");
+                    }
+                    tree = evalCond(args, frame); // Helper functions can make your code easier to navigate!
+                    continue;
+                }
+                default:
+                {
+                    Item *procedure = eval(first, frame);
+                    if (!isProcedure(procedure))
+                    {
+                        notAProcedure(args, frame);
+                    }
+                    tree = cons(procedure, cdr(tree));
+                    continue;
+                }
                 }
-                return evalOr(args, frame);
             }
-            else if (!strcmp(first->s, "cond"))
+
+            else if (typeOf(first) == CONS_TYPE || typeOf(first) == LOCAL_TYPE || typeOf(first) == GLOBAL_TYPE)
             {
-                if (args->type == NULL_TYPE || cdr(args)->type == NULL_TYPE)
+                // closures and primitives are both applied by evaluating the
+                // call again with the procedure in place of the expression
+                Item *first_result = eval(first, frame);
+                if (!isProcedure(first_result))
                 {
-                    evaluationError("incorrect cond format");
+                    notAProcedure(args, frame);
                 }
-                return evalCond(args, frame); // Helper functions can make your code easier to navigate!
+                tree = cons(first_result, cdr(tree));
+                continue;
             }
-
             else
             {
-                return eval(cons(eval(first, frame), args), frame);
+                notAProcedure(args, frame);
             }
+            break;
         }
-
-        else
+        default:
         {
-            if (first->type == CONS_TYPE)
-            {
-                Item *first_result = eval(first, frame);
-                if (first_result->type == CLOSURE_TYPE)
-                {
-                    return eval(cons(first_result, args), frame);
-                }
-                else if (first_result->type == PRIMITIVE_TYPE)
-                {
-                    return first_result->pf(evaluateArgs(args, frame));
-                }
-                else
-                {
-                    return eval(cons(first_result, args), frame);
-                }
-            }
+            break;
         }
+        }
+        break;
     }
-    default:
+
+    gcPop(roots);
+    return result;
+}
+
+// Takes a pointer to a parse tree item type and a pointer to a frame
+// evaluates the parse tree within the frame and returns the result of evaluation
+Item *eval(Item *tree, Frame *frame)
+{
+    Item *result = evalTail(tree, frame);
+    if (result == TAIL_CALL)
     {
-        return 0;
-    }
+        result = applyLambda(pendingClosure, pendingArgs);
     }
-
-    return 0;
+    return result;
 }
@@ -1,10 +1,172 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "item.h"
 
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
-void interpret(Item *tree);
+// Takes the resolved parse tree and runs each top-level form in turn, printing
+// its value. With vm set, forms are compiled and run by the bytecode VM
+// instead of being walked by eval. A program can be handed over a few forms
+// at a time, in as many calls as it takes.
+void interpret(Item *tree, bool vm);
 Item *eval(Item *tree, Frame *frame);
 
-#endif
+// Returned in place of a value by evalTail and by analysed lambda bodies when
+// what is left to do is a call to a closure, which tailCall has recorded.
+// applyLambda makes the call without taking any more C stack.
+extern Item tailCallMarker;
+#define TAIL_CALL (&tailCallMarker)
+
+Item *evalTail(Item *tree, Frame *frame);
+Item *tailCall(Item *closure, Item *args);
+
+// Shared with the bytecode compiler, the VM and the analyser
+void evaluationError(char *error);
+bool inList(Item *symbol, Item *list);
+Item *makeLambda(Item *args, Frame *frame);
+Item *applyLambda(Item *closure, Item *args);
+Frame *makeFrame(Frame *parent, Item *names, int size);
+Item *getsymbolfromframe(Item *symbol, Frame *frame);
+Item *getGlobalCell(Item *global);
+void setVariable(Item *variable, Item *value, Frame *frame);
+void defineVariable(Item *symbol, Item *value, Frame *frame);
+Item *applyContinuation(Item *continuation, Item *args);
+Item *p_callcc(int argc, Item **argv);
+
+// Returns true if the item can be applied: a closure, a primitive or a
+// continuation. Applying anything else is an evaluation error in both
+// evaluators.
+static inline bool isProcedure(Item *item)
+{
+    itemType type = typeOf(item);
+    return type == CLOSURE_TYPE || type == PRIMITIVE_TYPE || type == CONTINUATION_TYPE;
+}
+
+// Primitives are handed their arguments as an array and a count, which their
+// caller checks against the primitive's arity, so the primitives themselves
+// only check types. The tree walker and the analyser push arguments on an
+// argument stack and the VM hands over a slice of its value stack, so calling
+// a primitive allocates nothing.
+void arityError(Item *primitive);
+size_t argumentCount();
+void pushArgument(Item *argument);
+Item *applyPrimitive(Item *primitive, size_t base);
+
+// Takes a primitive and its arguments, and returns the result of calling it,
+// or produces an evaluation error if it takes a different number of arguments
+static inline Item *callPrimitive(Item *primitive, int argc, Item **argv)
+{
+    if (argc < primitive->prim.minArgs || (primitive->prim.maxArgs >= 0 && argc > primitive->prim.maxArgs))
+    {
+        arityError(primitive);
+    }
+    return primitive->prim.pf(argc, argv);
+}
 
+// The primitives whose calls with two integers are worth making without
+// calling them. The analyser and the compiler look for calls to the globals
+// bound to these, and make them inline while the global still holds the
+// primitive and both arguments are integers, falling back to calling the
+// primitive on anything else.
+typedef enum
+{
+    ARITHMETIC_NONE,
+    ARITHMETIC_ADD,
+    ARITHMETIC_SUBTRACT,
+    ARITHMETIC_MULTIPLY,
+    ARITHMETIC_LESS,
+    ARITHMETIC_GREATER,
+    ARITHMETIC_EQUAL
+} arithmeticOp;
+
+Item *p_plus(int argc, Item **argv);
+Item *p_minus(int argc, Item **argv);
+Item *p_mult(int argc, Item **argv);
+Item *p_l(int argc, Item **argv);
+Item *p_g(int argc, Item **argv);
+Item *p_e(int argc, Item **argv);
+
+// Takes a symbol and returns the operation of the primitive it is bound to
+// at the start of a run, or ARITHMETIC_NONE
+arithmeticOp arithmeticOperation(Item *symbol);
+
+// Takes an operation and a procedure, and returns whether the procedure is
+// still the primitive for that operation
+static inline bool isArithmeticPrimitive(arithmeticOp op, Item *procedure)
+{
+    if (typeOf(procedure) != PRIMITIVE_TYPE)
+    {
+        return false;
+    }
+    Item *(*pf)(int argc, Item **argv) = procedure->prim.pf;
+    switch (op)
+    {
+    case ARITHMETIC_ADD:
+        return pf == p_plus;
+    case ARITHMETIC_SUBTRACT:
+        return pf == p_minus;
+    case ARITHMETIC_MULTIPLY:
+        return pf == p_mult;
+    case ARITHMETIC_LESS:
+        return pf == p_l;
+    case ARITHMETIC_GREATER:
+        return pf == p_g;
+    case ARITHMETIC_EQUAL:
+        return pf == p_e;
+    default:
+        return false;
+    }
+}
+
+// Takes an operation and its two arguments, and if both are integers and the
+// result fits in one, stores the result and returns true. Returns false,
+// leaving the call to the primitive, otherwise.
+static inline bool fixnumArithmetic(arithmeticOp op, Item *a, Item *b, Item **result)
+{
+    if (((intptr_t)a & (intptr_t)b & FIXNUM_TAG) == 0)
+    {
+        return false;
+    }
+    int x = intValue(a);
+    int y = intValue(b);
+    int value;
+    switch (op)
+    {
+    case ARITHMETIC_ADD:
+        if (__builtin_add_overflow(x, y, &value))
+        {
+            return false;
+        }
+        *result = makeInt(value);
+        return true;
+    case ARITHMETIC_SUBTRACT:
+        if (__builtin_sub_overflow(x, y, &value))
+        {
+            return false;
+        }
+        *result = makeInt(value);
+        return true;
+    case ARITHMETIC_MULTIPLY:
+        if (__builtin_mul_overflow(x, y, &value))
+        {
+            return false;
+        }
+        *result = makeInt(value);
+        return true;
+    case ARITHMETIC_LESS:
+        *result = makeBool(x < y);
+        return true;
+    case ARITHMETIC_GREATER:
+        *result = makeBool(x > y);
+        return true;
+    case ARITHMETIC_EQUAL:
+        *result = makeBool(x == y);
+        return true;
+    default:
+        return false;
+    }
+}
+
+#endif
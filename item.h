@@ -1,3 +1,6 @@
+#include <stdint.h>
+#include <stdbool.h>
+
 #ifndef ITEM_H
 #define ITEM_H
 
@@ -12,7 +15,16 @@ typedef enum {
     VOID_TYPE, CLOSURE_TYPE,
 
     // Type below is new for primitive portion
-    PRIMITIVE_TYPE
+    PRIMITIVE_TYPE,
+
+    // Types below are only produced by the resolver
+    LOCAL_TYPE, GLOBAL_TYPE,
+
+    // Type below is made by call-with-current-continuation
+    CONTINUATION_TYPE,
+
+    // Type below is made by integer arithmetic that overflows an int
+    BIGNUM_TYPE
 } itemType;
 
 struct Item {
@@ -22,6 +34,22 @@ struct Item {
         double d;
         char *s;
         void *p;
+
+        // A string's text, quotes included. It is not null-terminated, and
+        // either points straight into the source file or, if collected is
+        // set, is a block of its own in the collected heap.
+        struct String {
+            char *chars;
+            int length;
+            bool collected;
+        } str;
+
+        // A symbol's name (also reachable as s), and which special form it
+        // names, as a formId from symbols.h
+        struct Symbol {
+            char *name;
+            int form;
+        } sym;
         struct ConsCell {
             struct Item *car;
             struct Item *cdr;
@@ -38,25 +66,135 @@ struct Item {
         } cl;
         
         // A primitive style function; just a pointer to it, with the right
-        // signature (pf = primitive function)
-        struct Item *(*pf)(struct Item *);
+        // signature (pf = primitive function), its name, and the fewest and
+        // most arguments it takes, where a maximum of -1 means any number.
+        // It is handed its arguments as an array, which is only valid until
+        // it evaluates anything.
+        struct Primitive {
+            struct Item *(*pf)(int argc, struct Item **argv);
+            char *name;
+            int minArgs;
+            int maxArgs;
+        } prim;
+
+        // Compiled bytecode or analysed nodes (a PTR_TYPE item), and the
+        // frame of the unit they were made in, which holds the heap items and
+        // blocks they need and lives as long as some item points at it
+        struct CodeRef {
+            void *address;
+            struct Frame *unit;
+        } code;
+
+        // A reference to a local variable, resolved ahead of time to the
+        // number of frames up it is bound and its slot in that frame. The
+        // symbol is kept for error messages.
+        struct LocalRef {
+            int depth;
+            int index;
+            struct Item *name;
+        } lr;
+
+        // A reference the resolver has proven can only mean a global
+        // variable, and the global binding cell once it has been looked up
+        struct GlobalRef {
+            struct Item *name;
+            struct Item *cell;
+        } gr;
+
+        // A continuation captured by call/cc: the frame to go back to, the
+        // value stack below the call once it has had to be saved (the VM
+        // only), and whatever else the evaluator that captured it needs to
+        // resume it, which never points into the collected heap
+        struct Continuation {
+            struct Frame *frame;
+            struct Frame *saved;
+            void *state;
+        } k;
+
+        // An integer too big for an int: its magnitude as 32-bit digits,
+        // least significant first, in a block of its own, and its sign.
+        // Bignums are never changed once made, and never hold a value that
+        // fits in an int.
+        struct Bignum {
+            uint32_t *digits;
+            int length;
+            bool negative;
+        } big;
     };
 };
 
 typedef struct Item Item;
 
+// Integers, booleans, the empty list and void are never allocated: they are
+// encoded directly in the Item pointer instead. Heap items are always 8-byte
+// aligned, so a real pointer has its low bits clear. An integer sets the low
+// bit and keeps its value in the rest of the word, and the other constants
+// set the second bit instead. Use typeOf rather than ->type on any Item that
+// might be one of these.
+#define FIXNUM_TAG 1
+#define CONSTANT_TAG 2
+
+#define NULL_ITEM ((Item *)(intptr_t)(0 << 2 | CONSTANT_TAG))
+#define FALSE_ITEM ((Item *)(intptr_t)(1 << 2 | CONSTANT_TAG))
+#define TRUE_ITEM ((Item *)(intptr_t)(2 << 2 | CONSTANT_TAG))
+#define VOID_ITEM ((Item *)(intptr_t)(3 << 2 | CONSTANT_TAG))
+
+// Returns true if the item is encoded in the pointer rather than allocated
+static inline bool isImmediate(Item *item)
+{
+    return ((intptr_t)item & (FIXNUM_TAG | CONSTANT_TAG)) != 0;
+}
+
+// Returns the type of an item, whether it is allocated or immediate
+static inline itemType typeOf(Item *item)
+{
+    if ((intptr_t)item & FIXNUM_TAG)
+    {
+        return INT_TYPE;
+    }
+    if ((intptr_t)item & CONSTANT_TAG)
+    {
+        if (item == NULL_ITEM)
+        {
+            return NULL_TYPE;
+        }
+        return item == VOID_ITEM ? VOID_TYPE : BOOL_TYPE;
+    }
+    return item->type;
+}
+
+// Takes an int and returns the immediate item encoding it
+static inline Item *makeInt(int i)
+{
+    return (Item *)(((uintptr_t)(intptr_t)i << 1) | FIXNUM_TAG);
+}
 
-// A frame is a linked list of bindings, and a pointer to another frame.  A
-// binding is a variable name (represented as a string), and a pointer to the
-// Value it is bound to. I'm just going to put these in a flat list, with every
-// other element being a symbol, and the following element being the value. I
-// could do this via yet another data structure, but I think this will
-// ultimately take less coding. It also will require less modification of
-// existing code.
+// Takes an item of INT_TYPE and returns its value
+static inline int intValue(Item *item)
+{
+    return (int)((intptr_t)item >> 1);
+}
+
+// Takes a C truth value and returns #t or #f
+static inline Item *makeBool(bool b)
+{
+    return b ? TRUE_ITEM : FALSE_ITEM;
+}
+
+
+// A frame holds the variables of one procedure call, let, let* or letrec.
+// Their values sit in an inline array of slots, in the order the variables
+// are declared, and names is the parameter list or binding list they were
+// declared by, so a variable can still be found by name. Bindings added at
+// run time by define, and every binding of the global frame, go on the
+// bindings list as (symbol . value) pairs instead.
 
 struct Frame {
-    struct Item *bindings;
     struct Frame *parent;
+    struct Item *names;
+    struct Item *bindings;
+    int size;
+    struct Item *slots[];
 };
 
 typedef struct Frame Frame;
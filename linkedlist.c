@@ -7,19 +7,18 @@
 #include <assert.h>
 #include <string.h>
 #include "talloc.h"
+#include "gc.h"
 
-// Takes no arguments and returns a new NULL_TYPE item node.
+// Takes no arguments and returns the empty list, which is never allocated.
 Item *makeNull()
 {
-    Item *item = talloc(sizeof(Item));
-    item->type = NULL_TYPE;
-    return item;
+    return NULL_ITEM;
 }
 
 // Takes a car and cdr and creates a cons type item node with the car and cdr.
 Item *cons(Item *newCar, Item *newCdr)
 {
-    Item *item = talloc(sizeof(Item));
+    Item *item = gcItem();
     item->type = CONS_TYPE;
     item->c.car = newCar;
     item->c.cdr = newCdr;
@@ -29,10 +28,10 @@ Item *cons(Item *newCar, Item *newCdr)
 // Takes an int,double,or str Item node and prints its content followed by a ->
 void print(Item *current)
 {
-    switch (current->type)
+    switch (typeOf(current))
     {
     case INT_TYPE:
-        printf("%d", current->i);
+        printf("%d", intValue(current));
         printf("->");
         return;
     case DOUBLE_TYPE:
@@ -40,7 +39,7 @@ void print(Item *current)
         printf("->");
         break;
     case STR_TYPE:
-        printf("%s", current->s);
+        printf("%.*s", current->str.length, current->str.chars);
         printf("->");
         break;
     default:
@@ -59,7 +58,7 @@ void display(Item *list)
     while (!isNull(current))
     {
 
-        if (current->type == CONS_TYPE)
+        if (typeOf(current) == CONS_TYPE)
         {
             print(car(current));
             if (current->c.cdr != NULL)
@@ -86,20 +85,16 @@ void display(Item *list)
 // Takes an two pointers to Items destination and source and copies the source to destination without pointing to source
 void copy(Item *destination, Item *source)
 {
-    switch (source->type)
+    switch (typeOf(source))
     {
-    case INT_TYPE:
-        destination->type = INT_TYPE;
-        destination->i = source->i;
-        break;
     case DOUBLE_TYPE:
         destination->type = DOUBLE_TYPE;
         destination->d = source->d;
         break;
     case STR_TYPE:
+        // strings never change, so the text can be shared
         destination->type = STR_TYPE;
-        destination->s = talloc(sizeof(source->s));
-        strcpy(destination->s, source->s);
+        destination->str = source->str;
         break;
     default:
         break;
@@ -116,10 +111,10 @@ Item *reverse(Item *list)
         newList = makeNull();
         return newList;
     }
-    assert(list->type == CONS_TYPE);
+    assert(typeOf(list) == CONS_TYPE);
 
     Item *current = list;
-    Item *prev = talloc(sizeof(Item));
+    Item *prev = gcItem();
     prev->type = CONS_TYPE;
 
     prev->c.cdr = makeNull();
@@ -127,15 +122,15 @@ Item *reverse(Item *list)
     int i = 0;
     while (!isNull(current))
     {
-        Item *toBeAdded = talloc(sizeof(Item));
-        if (current->type == CONS_TYPE)
+        Item *toBeAdded;
+        if (typeOf(current) == CONS_TYPE)
         {
             toBeAdded = car(current);
             //  copy(toBeAdded, car(current));
 
             if (prev->c.car != NULL)
             {
-                Item *nextprev = talloc(sizeof(Item));
+                Item *nextprev = gcItem();
                 nextprev->type = CONS_TYPE;
                 nextprev->c.cdr = prev;
                 prev = nextprev;
@@ -157,14 +152,14 @@ Item *reverse(Item *list)
 // Takes an pointer to Item of type cons_type and returns a pointer to its car. Discontinues the program of invalid input
 Item *car(Item *list)
 {
-    assert(list->type == CONS_TYPE);
+    assert(typeOf(list) == CONS_TYPE);
     return list->c.car;
 }
 
 // Takes an pointer to Item of type cons_type and returns a pointer to its cdr. Discontinues the program of invalid input
 Item *cdr(Item *list)
 {
-    assert(list->type == CONS_TYPE);
+    assert(typeOf(list) == CONS_TYPE);
     return list->c.cdr;
 }
 
@@ -172,7 +167,7 @@ Item *cdr(Item *list)
 bool isNull(Item *item)
 {
     assert(item != NULL);
-    return item->type == NULL_TYPE;
+    return item == NULL_ITEM;
 }
 
 // Takes a pointer to Item head and returns the length of the linkedlist
@@ -185,7 +180,7 @@ int length(Item *list)
 
     while (!isNull(current))
     {
-        if (current->type == CONS_TYPE)
+        if (typeOf(current) == CONS_TYPE)
         {
             if (cdr(current) == NULL)
             {
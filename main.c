@@ -1,16 +1,118 @@
 #include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
 #include "tokenizer.h"
 #include "item.h"
 #include "linkedlist.h"
 #include "parser.h"
 #include "talloc.h"
+#include "gc.h"
+#include "resolver.h"
 #include "interpreter.h"
+#include "stack.h"
+#include "vm.h"
 
-int main()
+// Takes the name the program was run as and prints how to run it to stderr
+static void usage(char *program)
 {
-    Item *list = tokenize();
-    Item *tree = parse(list);
-    interpret(tree);
+    fprintf(stderr, "Usage: %s [--vm] [--stream] [--gc-stats] [--stack-stats] [--read-stats] [script.scm]\n", program);
+    fprintf(stderr, "Runs the script, or the program on stdin if no script is named.\n");
+}
+
+int main(int argc, char **argv)
+{
+    char base;
+    stackInit(&base);
+
+    bool gcStats = false;
+    bool stackStats = false;
+    bool vm = false;
+    bool readStats = false;
+    bool stream = false;
+    char *path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--gc-stats"))
+        {
+            gcStats = true;
+        }
+        else if (!strcmp(argv[i], "--stack-stats"))
+        {
+            stackStats = true;
+        }
+        else if (!strcmp(argv[i], "--read-stats"))
+        {
+            readStats = true;
+        }
+        else if (!strcmp(argv[i], "--stream"))
+        {
+            stream = true;
+        }
+        else if (!strcmp(argv[i], "--vm"))
+        {
+            vm = true;
+        }
+        else if (!strncmp(argv[i], "--", 2))
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        else if (path != NULL)
+        {
+            fprintf(stderr, "Only one script can be run at a time, but both %s and %s were given\n", path, argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            // anything that is not an option is the script to run
+            path = argv[i];
+        }
+    }
+
+    if (path != NULL)
+    {
+        tokenizerOpen(path);
+    }
+    if (stream)
+    {
+        // each form is read, then run before the next one is read, so only
+        // one form's tree is held at a time
+        Item *form;
+        while ((form = parseForm()) != NULL)
+        {
+            Item *tree = cons(form, makeNull());
+            resolve(tree);
+            interpret(tree, vm);
+        }
+    }
+    else
+    {
+        Item *tree = parse();
+        resolve(tree);
+        interpret(tree, vm);
+    }
+    if (readStats)
+    {
+        parsePrintStats();
+    }
+    if (gcStats)
+    {
+        gcPrintStats();
+    }
+    if (stackStats)
+    {
+        // the evaluator in use is the only one with anything to report
+        if (vm)
+        {
+            vmPrintStats();
+        }
+        else
+        {
+            stackPrintStats();
+        }
+    }
     tfree();
     return 0;
 }
@@ -1,286 +1,178 @@
 #include "tokenizer.h"
-
 #include <stdlib.h>
-
 #include <stdio.h>
-
+#include <time.h>
 #include "talloc.h"
-
+#include "gc.h"
 #include "linkedlist.h"
-
 #include "parser.h"
-
+#include "bignum.h"
+#include "stack.h"
 #include "string.h"
 
-// stack helper functions
-
-typedef struct
-
-{
-
-    Item *top;
-
-} Stack;
-
-// creates new stack
+// The reader pulls tokens from the tokenizer one at a time and builds each
+// datum as it goes, recursing once for every level of nesting, so no list of
+// tokens is ever made. Nothing it allocates can be collected while it runs,
+// since there is no safepoint until it returns.
 
-void initializeStack(Stack *stack)
+static size_t formsRead = 0;
+static double readTime = 0;
 
+// Returns the current time in milliseconds
+static double now()
 {
-
-    stack->top = makeNull();
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
 }
 
-// pushes an item to the top of the stack
-
-void push(Stack *stack, Item *item)
+static Item *readDatum(Item *token);
 
+// What readList needs to be run on a new segment of stack
+typedef struct
 {
+    itemType open;
+    Item *result;
+} DeferredList;
 
-    // Add item to the top of the stack
-
-    stack->top = cons(item, stack->top);
-}
-
-// checks if the stack is empty
-
-int isEmpty(Stack *stack)
+static Item *readList(itemType open);
 
+// Takes a DeferredList and reads its list
+static void readListOnNewSegment(void *argument)
 {
-
-    return stack->top == NULL || isNull(stack->top);
+    DeferredList *list = argument;
+    list->result = readList(list->open);
 }
 
-// pops the top item off of the stack
-
-Item *pop(Stack *stack)
-
+// Takes the type of the token that opened a list, reads the rest of the list
+// up to the matching close and returns it. An empty list reads as a list
+// holding ().
+static Item *readList(itemType open)
 {
-
-    if (isEmpty(stack))
-
+    // deeply nested data would otherwise overflow the C stack
+    if (stackNearlyFull())
     {
-
-        return NULL;
+        DeferredList list = {open, NULL};
+        stackRunOnNewSegment(readListOnNewSegment, &list);
+        return list.result;
     }
 
-    // Retrieve the top item
-
-    Item *topItem = car(stack->top);
-
-    // Update the stack to remove the top item
-
-    stack->top = cdr(stack->top);
-
-    return topItem;
-}
-
-// Takes a (linked) list of tokens from a Scheme program, and returns a pointer to a
-
-// parse tree representing that program.
-
-Item *parse(Item *tokens)
-
-{
-
-    // initialize stack
-
-    Stack stack;
-
-    initializeStack(&stack);
-
-    Stack parenStack;
-
-    initializeStack(&parenStack);
-
-    int parenthesesToClose = 0;
-
-    Item *poppedItem = NULL;
-
-    char prevType;
-
-    // while there are more tokens in the list
-
-    while (!isNull(tokens))
-
+    Item *head = makeNull();
+    Item *last = NULL;
+    while (true)
     {
-
-        // get next token
-
-        Item *nextToken;
-
-        nextToken = car(tokens);
-
-        // if next token is not close paren/bracket:
-
-        if (nextToken->type != CLOSE_TYPE && nextToken->type != CLOSEBRACKET_TYPE)
-
+        Item *token = readToken();
+        if (token == NULL)
         {
+            printf("Syntax error: not enough close parentheses\n");
+            texit(1);
+        }
 
-            // if next token is an open paren/bracket
-
-            if (nextToken->type == OPEN_TYPE || nextToken->type == OPENBRACKET_TYPE)
-
-            {
-
-                parenthesesToClose++;
-
-                Item *paren;
-
-                paren = talloc(sizeof(Item));
-
-                if (nextToken->type == OPEN_TYPE)
-
-                {
-
-                    paren->type = OPEN_TYPE;
-
-                    push(&parenStack, paren);
-
-                    // printf("prev type is %c\n", prevType);
-                }
-
-                else
-
-                {
-
-                    paren->type = OPENBRACKET_TYPE;
-
-                    push(&parenStack, paren);
-
-                    // push(&parenStack, '[');
-
-                    // printf("prev type is %c\n", prevType);
-                }
-            }
-
-            // push token to the stack
-
-            push(&stack, nextToken);
+        itemType type = typeOf(token);
+        if (type == CLOSE_TYPE && open == OPENBRACKET_TYPE)
+        {
+            printf("Syntax error: open was a bracket and close was a parentheses\n");
+            texit(1);
+        }
+        if (type == CLOSEBRACKET_TYPE && open == OPEN_TYPE)
+        {
+            printf("Syntax error: open was a parentheses and close was a bracket\n");
+            texit(1);
+        }
+        if (type == CLOSE_TYPE || type == CLOSEBRACKET_TYPE)
+        {
+            break;
         }
 
+        // the list is built in order; with no collection until the reader
+        // returns, last is never older than the new cell
+        Item *cell = cons(readDatum(token), makeNull());
+        if (last == NULL)
+        {
+            head = cell;
+        }
         else
-
-        { // nextToken is a close paren/bracket
-
-            if (parenthesesToClose <= 0)
-
-            {
-
-                printf("Syntax error: too many close parentheses\n");
-
-                texit(1);
-            }
-
-            // use a stack to track previous parentheses/brackets in order
-
-            Item *lastParen;
-
-            lastParen = pop(&parenStack);
-
-            // if parenthese/brackets don't match up
-
-            if (nextToken->type == CLOSE_TYPE && lastParen->type == OPENBRACKET_TYPE)
-
-            {
-
-                printf("Syntax error: open was a bracket and close was a parentheses\n");
-
-                texit(1);
-            }
-
-            if (nextToken->type == CLOSEBRACKET_TYPE && lastParen->type == OPEN_TYPE)
-
-            {
-
-                printf("Syntax error: open was a parentheses and close was a bracket\n");
-
-                texit(1);
-            }
-
-            // pop item off the stack
-
-            if (poppedItem == NULL)
-
-            {
-
-                poppedItem = makeNull();
-            }
-
-            Item *subTree = poppedItem;
-
-            poppedItem = pop(&stack);
-
-            // while popped item is not an open paren/bracket
-
-            while (poppedItem != NULL && poppedItem->type != OPEN_TYPE && poppedItem->type != OPENBRACKET_TYPE)
-
-            {
-
-                // add popped item to subtree
-
-                subTree = cons(poppedItem, subTree);
-
-                // pop off next item
-
-                poppedItem = pop(&stack);
-            }
-
-            // checks the edge case that nothing was put into the subtree
-
-            if (isNull(subTree))
-
-            {
-
-                subTree = cons(subTree, subTree);
-            }
-
-            parenthesesToClose--;
-
-            // item was an open paren/bracket so push subtree to stack
-
-            push(&stack, subTree);
-
-            poppedItem = NULL;
+        {
+            last->c.cdr = cell;
         }
-
-        tokens = cdr(tokens);
+        last = cell;
     }
 
-    if (parenthesesToClose < 0)
-
+    if (isNull(head))
     {
+        head = cons(head, head);
+    }
+    return head;
+}
 
+// Takes the first token of a datum, reads the rest of the datum and returns it
+static Item *readDatum(Item *token)
+{
+    itemType type = typeOf(token);
+    if (type == OPEN_TYPE || type == OPENBRACKET_TYPE)
+    {
+        return readList(type);
+    }
+    if (type == CLOSE_TYPE || type == CLOSEBRACKET_TYPE)
+    {
         printf("Syntax error: too many close parentheses\n");
-
         texit(1);
     }
+    return token;
+}
 
-    else if (parenthesesToClose > 0)
-
+// Reads the whole input and returns a list of its top-level forms
+Item *parse()
+{
+    double start = now();
+    Item *head = makeNull();
+    Item *last = NULL;
+    Item *token;
+    while ((token = readToken()) != NULL)
     {
-
-        printf("Syntax error: not enough close parentheses\n");
-
-        texit(1);
+        Item *cell = cons(readDatum(token), makeNull());
+        if (last == NULL)
+        {
+            head = cell;
+        }
+        else
+        {
+            last->c.cdr = cell;
+        }
+        last = cell;
+        formsRead++;
     }
+    readTime += now() - start;
+    return head;
+}
 
-    // turn stack into a linked list in order of the program
-
-    Item *list = makeNull();
-
-    Item *sExpr;
-
-    while (!isEmpty(&stack))
-
+// Reads the next top-level form from the input and returns it, or NULL at the
+// end of the input
+Item *parseForm()
+{
+    double start = now();
+    Item *token = readToken();
+    Item *form = NULL;
+    if (token != NULL)
     {
-
-        sExpr = pop(&stack);
-
-        list = cons(sExpr, list);
+        form = readDatum(token);
+        formsRead++;
     }
+    readTime += now() - start;
+    return form;
+}
 
-    return list;
+// Prints the number of bytes, tokens and top-level forms read, the time spent
+// reading them and the throughput to stderr
+void parsePrintStats()
+{
+    size_t bytes = tokenizerBytesRead();
+    double megabytes = bytes / (1024.0 * 1024.0);
+    fprintf(stderr, "read bytes:           %zu\n", bytes);
+    fprintf(stderr, "read tokens:          %zu\n", tokenizerTokensRead());
+    fprintf(stderr, "read forms:           %zu\n", formsRead);
+    fprintf(stderr, "read time:            %.3f ms\n", readTime);
+    fprintf(stderr, "read throughput:      %.1f MB/s\n", readTime > 0 ? megabytes / (readTime / 1000.0) : 0.0);
 }
 
 // Prints the tree to the screen in a readable fashion. It should look just like
@@ -290,119 +182,136 @@ Item *parse(Item *tokens)
 void printTree(Item *tree)
 
 {
+    // the rest of a list is printed by going round again rather than by
+    // recursing, so printing a long list uses no more C stack than a short one
+    while (true)
+    {
+        if (tree == NULL || isNull(tree))
 
-    if (tree == NULL || isNull(tree))
+        {
 
-    {
+            // printf("the tree was null\n");
 
-        // printf("the tree was null\n");
+            return;
+        }
 
-        return;
-    }
+        // printf("(");
 
-    // printf("(");
+        switch (typeOf(tree))
 
-    switch (tree->type)
+        {
 
-    {
+        case INT_TYPE:
 
-    case INT_TYPE:
+            printf("%i", intValue(tree));
 
-        printf("%i", tree->i);
+            break;
 
-        break;
+        case BIGNUM_TYPE:
 
-    case DOUBLE_TYPE:
+            bignumPrint(tree);
 
-        printf("%f", tree->d);
+            break;
 
-        break;
+        case DOUBLE_TYPE:
 
-    case STR_TYPE:
+            printf("%f", tree->d);
 
-        printf("%s", tree->s);
-        break;
+            break;
 
-    case BOOL_TYPE:
+        case STR_TYPE:
 
-        printf("%s", tree->s);
+            printf("%.*s", tree->str.length, tree->str.chars);
+            break;
 
-        break;
+        case BOOL_TYPE:
 
-    case SYMBOL_TYPE:
+            printf("%s", tree == TRUE_ITEM ? "#t" : "#f");
 
-        printf("%s", tree->s);
+            break;
 
-        break;
+        case SYMBOL_TYPE:
 
-    case CONS_TYPE:
+            printf("%s", tree->s);
 
-        // Recursively print children (car and cdr)
+            break;
 
-        if (car(tree)->type == CONS_TYPE)
+        case CONS_TYPE:
 
-        {
+            // Recursively print the car, then go round again for the cdr
 
-            // is internal node?
+            if (typeOf(car(tree)) == CONS_TYPE)
 
-            printf("(");
+            {
 
-            printTree(tree->c.car);
+                // is internal node?
 
-            printf(") ");
+                printf("(");
 
-            // Changed this on May 24th
+                printTree(tree->c.car);
 
-            if (cdr(tree)->type != CONS_TYPE && cdr(tree)->type != NULL_TYPE)
-            {
+                printf(") ");
 
-                printf(" . ");
+                // Changed this on May 24th
 
-                printTree(tree->c.cdr);
-            }
+                if (typeOf(cdr(tree)) != CONS_TYPE && typeOf(cdr(tree)) != NULL_TYPE)
+                {
 
-            else
-            {
+                    printf(" . ");
 
-                printf(" ");
+                    tree = tree->c.cdr;
+                    continue;
+                }
+
+                else
+                {
 
-                printTree(tree->c.cdr);
+                    printf(" ");
+
+                    tree = tree->c.cdr;
+                    continue;
+                }
             }
-        }
 
-        else
+            else
 
-        {
+            {
 
-            printTree(tree->c.car);
+                printTree(tree->c.car);
 
-            if (tree->c.cdr->type == CONS_TYPE)
+                if (typeOf(tree->c.cdr) == CONS_TYPE)
 
-            {
+                {
 
-                // there is another item after, so it needs the space
+                    // there is another item after, so it needs the space
 
-                printf(" ");
-            }
+                    printf(" ");
+                }
 
-            else if (!isNull(cdr(tree)))
-            {
+                else if (!isNull(cdr(tree)))
+                {
+
+                    printf(" . ");
+                }
 
-                printf(" . ");
+                tree = tree->c.cdr;
+                continue;
             }
 
-            printTree(tree->c.cdr);
+            break;
+        case CLOSURE_TYPE:
+            printf("#<procedure>");
+            break;
+        case PRIMITIVE_TYPE:
+            printf("primitive");
+            break;
+        case CONTINUATION_TYPE:
+            printf("#<continuation>");
+            break;
+        default:
+
+            break;
         }
-
-        break;
-    case CLOSURE_TYPE:
-        printf("#<procedure>");
-        break;
-    case PRIMITIVE_TYPE:
-        printf("primitive");
-        break;
-    default:
-
-        break;
+        return;
     }
 }
@@ -3,9 +3,17 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-// Takes a list of tokens from a Scheme program, and returns a pointer to a
-// parse tree representing that program.
-Item *parse(Item *tokens);
+// Reads the whole input, from stdin unless tokenizerOpen named a file, and
+// returns a list of its top-level forms.
+Item *parse();
+
+// Reads the next top-level form from the input and returns it, or NULL at the
+// end of the input.
+Item *parseForm();
+
+// Prints the number of bytes, tokens and top-level forms read, the time spent
+// reading them and the throughput to stderr.
+void parsePrintStats();
 
 
 // Prints the tree to the screen in a readable fashion. It should look just like
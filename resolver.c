@@ -0,0 +1,344 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "item.h"
+#include "gc.h"
+#include "linkedlist.h"
+#include "symbols.h"
+#include "resolver.h"
+
+// A scope mirrors one frame that the interpreter will create at run time.
+// Its variables are the first length entries of vars, in slot order, where
+// each entry is either a symbol (lambda parameters) or a (symbol init)
+// binding (let, let* and letrec). A variadic lambda's scope has the lone
+// parameter symbol as vars. An opaque scope has a define somewhere that may add bindings to its
+// frame at run time, so nothing at or beyond it can be resolved.
+typedef struct Scope
+{
+    Item *vars;
+    int length;
+    bool opaque;
+    struct Scope *parent;
+} Scope;
+
+static Item *elseSymbol;
+
+static Item *resolveExpression(Item *expression, Scope *scope);
+
+// Takes a list and returns its length, stopping at anything that is not a
+// cons cell
+static int lengthOf(Item *list)
+{
+    int length = 0;
+    while (typeOf(list) == CONS_TYPE)
+    {
+        length++;
+        list = cdr(list);
+    }
+    return length;
+}
+
+// Takes a symbol and a scope and returns the slot of the symbol among the
+// scope's variables, or -1 if the scope does not bind it. The first binding
+// wins, as it does when the frame is searched at run time. An empty
+// parameter or binding list parses as a list holding (), which takes no slot.
+static int indexInScope(Item *symbol, Scope *scope)
+{
+    if (typeOf(scope->vars) == SYMBOL_TYPE)
+    {
+        return scope->vars == symbol ? 0 : -1;
+    }
+
+    int index = 0;
+    Item *current = scope->vars;
+    for (int i = 0; i < scope->length; i++)
+    {
+        Item *var = car(current);
+        if (typeOf(var) == CONS_TYPE)
+        {
+            var = car(var);
+        }
+        if (var == symbol)
+        {
+            return index;
+        }
+        if (!isNull(var))
+        {
+            index++;
+        }
+        current = cdr(current);
+    }
+    return -1;
+}
+
+// Takes a symbol in expression position and returns a LOCAL_TYPE item for it
+// if it names a local variable, a GLOBAL_TYPE item if no enclosing scope can
+// bind it, or the symbol itself if an opaque scope is in the way
+static Item *resolveSymbol(Item *symbol, Scope *scope)
+{
+    int depth = 0;
+    while (scope != NULL)
+    {
+        if (scope->opaque)
+        {
+            return symbol;
+        }
+        int index = indexInScope(symbol, scope);
+        if (index >= 0)
+        {
+            Item *local = gcItem();
+            local->type = LOCAL_TYPE;
+            local->lr.depth = depth;
+            local->lr.index = index;
+            local->lr.name = symbol;
+            return local;
+        }
+        scope = scope->parent;
+        depth++;
+    }
+
+    Item *global = gcItem();
+    global->type = GLOBAL_TYPE;
+    global->gr.name = symbol;
+    return global;
+}
+
+// Takes an expression and returns true if evaluating it could run a define
+// that adds a binding to the frame it is evaluated in. Bodies of nested
+// lambdas and lets get their own frames and are not searched.
+static bool mayDefine(Item *expression)
+{
+    if (typeOf(expression) != CONS_TYPE)
+    {
+        return false;
+    }
+
+    formId form = formOf(car(expression));
+    if (form == FORM_DEFINE)
+    {
+        return true;
+    }
+    if (form == FORM_QUOTE || form == FORM_LAMBDA || form == FORM_LET_STAR || form == FORM_LETREC)
+    {
+        return false;
+    }
+    if (form == FORM_LET)
+    {
+        // only the initial values of a let are evaluated in this frame
+        if (typeOf(cdr(expression)) != CONS_TYPE)
+        {
+            return false;
+        }
+        Item *bindings = car(cdr(expression));
+        while (typeOf(bindings) == CONS_TYPE)
+        {
+            Item *binding = car(bindings);
+            if (typeOf(binding) == CONS_TYPE && typeOf(cdr(binding)) == CONS_TYPE && mayDefine(car(cdr(binding))))
+            {
+                return true;
+            }
+            bindings = cdr(bindings);
+        }
+        return false;
+    }
+
+    while (typeOf(expression) == CONS_TYPE)
+    {
+        if (mayDefine(car(expression)))
+        {
+            return true;
+        }
+        expression = cdr(expression);
+    }
+    return false;
+}
+
+// Takes a list of expressions and returns true if any of them may define
+static bool anyMayDefine(Item *list)
+{
+    while (typeOf(list) == CONS_TYPE)
+    {
+        if (mayDefine(car(list)))
+        {
+            return true;
+        }
+        list = cdr(list);
+    }
+    return false;
+}
+
+// Takes a list of bindings and returns true if any initial value may define
+static bool anyInitMayDefine(Item *bindings)
+{
+    while (typeOf(bindings) == CONS_TYPE)
+    {
+        Item *binding = car(bindings);
+        if (typeOf(binding) == CONS_TYPE && anyMayDefine(cdr(binding)))
+        {
+            return true;
+        }
+        bindings = cdr(bindings);
+    }
+    return false;
+}
+
+// Takes a cons cell and a scope and replaces the cell's car with its
+// resolved form
+static void resolveCar(Item *cell, Scope *scope)
+{
+    Item *resolved = resolveExpression(car(cell), scope);
+    if (resolved != car(cell))
+    {
+        cell->c.car = resolved;
+        gcWriteBarrier(cell);
+    }
+}
+
+// Takes a list of expressions and resolves each of them in place
+static void resolveEach(Item *list, Scope *scope)
+{
+    while (typeOf(list) == CONS_TYPE)
+    {
+        resolveCar(list, scope);
+        list = cdr(list);
+    }
+}
+
+// Takes a list of bindings and resolves each initial value in place
+static void resolveInits(Item *bindings, Scope *scope)
+{
+    while (typeOf(bindings) == CONS_TYPE)
+    {
+        Item *binding = car(bindings);
+        if (typeOf(binding) == CONS_TYPE)
+        {
+            resolveEach(cdr(binding), scope);
+        }
+        bindings = cdr(bindings);
+    }
+}
+
+// Takes the remaining bindings of a let* and its body and resolves them, one
+// frame per binding as evalLetStar creates them
+static void resolveLetStar(Item *bindings, Item *body, Scope *scope)
+{
+    if (typeOf(bindings) != CONS_TYPE)
+    {
+        resolveEach(body, scope);
+        return;
+    }
+
+    Item *binding = car(bindings);
+    if (typeOf(binding) == CONS_TYPE)
+    {
+        resolveEach(cdr(binding), scope);
+    }
+    Scope inner = {bindings, 1, scope->opaque, scope};
+    resolveLetStar(cdr(bindings), body, &inner);
+}
+
+// Takes an expression and the scope it will be evaluated in, resolves its
+// subexpressions in place and returns its resolved form
+static Item *resolveExpression(Item *expression, Scope *scope)
+{
+    if (typeOf(expression) == SYMBOL_TYPE)
+    {
+        return resolveSymbol(expression, scope);
+    }
+    if (typeOf(expression) != CONS_TYPE)
+    {
+        return expression;
+    }
+
+    formId form = formOf(car(expression));
+    Item *args = cdr(expression);
+    if (form == FORM_QUOTE)
+    {
+        return expression;
+    }
+    if (typeOf(args) != CONS_TYPE)
+    {
+        if (form == FORM_NONE)
+        {
+            resolveCar(expression, scope);
+        }
+        return expression;
+    }
+
+    if (form == FORM_LAMBDA)
+    {
+        Item *params = car(args);
+        Scope inner = {params, lengthOf(params), anyMayDefine(cdr(args)), scope};
+        resolveEach(cdr(args), &inner);
+    }
+    else if (form == FORM_LET)
+    {
+        Item *bindings = car(args);
+        resolveInits(bindings, scope);
+        Scope inner = {bindings, lengthOf(bindings), anyMayDefine(cdr(args)), scope};
+        resolveEach(cdr(args), &inner);
+    }
+    else if (form == FORM_LET_STAR)
+    {
+        Item *bindings = car(args);
+        bool opaque = anyInitMayDefine(bindings) || anyMayDefine(cdr(args));
+        Scope outer = {NULL_ITEM, 0, opaque, scope};
+        resolveLetStar(bindings, cdr(args), &outer);
+    }
+    else if (form == FORM_LETREC)
+    {
+        Item *bindings = car(args);
+        bool opaque = anyInitMayDefine(bindings) || anyMayDefine(cdr(args));
+        Scope inner = {bindings, lengthOf(bindings), opaque, scope};
+        resolveInits(bindings, &inner);
+        resolveEach(cdr(args), &inner);
+    }
+    else if (form == FORM_DEFINE)
+    {
+        // the name being defined stays a symbol
+        resolveEach(cdr(args), scope);
+    }
+    else if (form == FORM_SET)
+    {
+        resolveEach(args, scope);
+    }
+    else if (form == FORM_COND)
+    {
+        Item *clauses = args;
+        while (typeOf(clauses) == CONS_TYPE)
+        {
+            Item *clause = car(clauses);
+            if (typeOf(clause) == CONS_TYPE)
+            {
+                if (car(clause) == elseSymbol)
+                {
+                    resolveEach(cdr(clause), scope);
+                }
+                else
+                {
+                    resolveEach(clause, scope);
+                }
+            }
+            clauses = cdr(clauses);
+        }
+    }
+    else if (form != FORM_NONE)
+    {
+        // the remaining special forms evaluate their arguments as ordinary
+        // expressions
+        resolveEach(args, scope);
+    }
+    else
+    {
+        resolveEach(expression, scope);
+    }
+    return expression;
+}
+
+// Takes the list of top-level forms returned by parse() and rewrites every
+// resolvable variable reference into a LOCAL_TYPE or GLOBAL_TYPE item
+void resolve(Item *tree)
+{
+    elseSymbol = intern("else");
+
+    resolveEach(tree, NULL);
+}
@@ -0,0 +1,13 @@
+#include "item.h"
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+// Takes the list of top-level forms returned by parse() and rewrites, in
+// place, every reference to a local variable of a lambda, let, let* or letrec
+// into a LOCAL_TYPE item holding its frame depth and slot index, and every
+// reference that can only be global into a GLOBAL_TYPE item. References that
+// an internal define could shadow are left as symbols.
+void resolve(Item *tree);
+
+#endif
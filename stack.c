@@ -0,0 +1,199 @@
+// ucontext is only declared for programs asking for X/Open interfaces on some
+// systems
+#define _XOPEN_SOURCE 600
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <ucontext.h>
+#include <sys/resource.h>
+#include "stack.h"
+
+// Segments are switched to with ucontext, which saves and restores the
+// registers and the stack pointer. The evaluator never keeps heap pointers on
+// the C stack where the collector would have to find them (roots are
+// registered with gcPush), so nothing else needs to know which segment is in
+// use.
+#define STACK_SEGMENT_SIZE (4 * 1024 * 1024)
+// How much of a segment is kept back for whatever runs between two checks
+#define STACK_RED_ZONE (256 * 1024)
+// How much deeper the stack has to get before the next check records it
+#define STACK_MARK_STEP (16 * 1024)
+// The most of the main stack used when its limit is unknown or very large
+#define STACK_MAIN_SIZE (8 * 1024 * 1024)
+
+// A segment, linked to the next one down, and while it is in use, what to put
+// back when the evaluator returns to the one above it
+typedef struct Segment
+{
+    struct Segment *deeper;
+    struct Segment *shallower;
+    char *savedTop;
+    char *savedLimit;
+    char *savedMark;
+    size_t savedBelow;
+    ucontext_t context;
+    ucontext_t caller;
+    char memory[];
+} Segment;
+
+char *stackMark = NULL;
+
+// The top of the segment in use and the point where it is nearly used up.
+// The main stack is the segment in use until stackRunOnNewSegment is called.
+static char *stackTop = NULL;
+static char *stackLimit = NULL;
+
+// The bytes used in every segment between the main stack and the one in use
+static size_t usedBelow = 0;
+
+// The segments allocated and not yet freed, shallowest first, and the one in
+// use, which is NULL while on the main stack
+static Segment *segments = NULL;
+static Segment *current = NULL;
+
+// The function a new segment is to run, and its argument
+static void (*pendingFunction)(void *argument) = NULL;
+static void *pendingArgument = NULL;
+
+static size_t peakDepth = 0;
+static size_t segmentsInUse = 0;
+static size_t peakSegments = 0;
+
+// Takes the address of a local variable in main and records where the stack
+// starts and how far it may grow.
+void stackInit(char *base)
+{
+    size_t size = STACK_MAIN_SIZE;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < size)
+    {
+        size = limit.rlim_cur;
+    }
+    stackTop = base;
+    stackLimit = base - size + STACK_RED_ZONE;
+    stackMark = base;
+}
+
+// Takes the address of a local variable in a function that is about to go
+// deeper, records how deep the stack has got, and returns whether the current
+// segment is nearly used up
+bool stackCheck(char *position)
+{
+    size_t depth = usedBelow + (size_t)(stackTop - position);
+    if (depth > peakDepth)
+    {
+        peakDepth = depth;
+    }
+    if (position < stackLimit)
+    {
+        return true;
+    }
+    // nothing is recorded again until the stack gets another step deeper
+    char *mark = position - STACK_MARK_STEP;
+    stackMark = mark > stackLimit ? mark : stackLimit;
+    return false;
+}
+
+// Runs the function waiting for the segment that has just been switched to
+static void runPending()
+{
+    pendingFunction(pendingArgument);
+}
+
+// Takes a function and an argument for it, and calls it on a new segment of
+// stack, returning once it has returned
+void stackRunOnNewSegment(void (*function)(void *argument), void *argument)
+{
+    Segment *segment = current == NULL ? segments : current->deeper;
+    if (segment == NULL)
+    {
+        segment = malloc(sizeof(Segment) + STACK_SEGMENT_SIZE);
+        if (segment == NULL)
+        {
+            printf("Out of memory\n");
+            exit(1);
+        }
+        segment->deeper = NULL;
+        if (current == NULL)
+        {
+            segments = segment;
+        }
+        else
+        {
+            current->deeper = segment;
+        }
+    }
+
+    char marker;
+    segment->shallower = current;
+    segment->savedTop = stackTop;
+    segment->savedLimit = stackLimit;
+    segment->savedMark = stackMark;
+    segment->savedBelow = usedBelow;
+
+    usedBelow += (size_t)(stackTop - &marker);
+    stackTop = segment->memory + STACK_SEGMENT_SIZE;
+    stackLimit = segment->memory + STACK_RED_ZONE;
+    stackMark = stackTop;
+    current = segment;
+    segmentsInUse++;
+    if (segmentsInUse > peakSegments)
+    {
+        peakSegments = segmentsInUse;
+    }
+
+    getcontext(&segment->context);
+    segment->context.uc_stack.ss_sp = segment->memory;
+    segment->context.uc_stack.ss_size = STACK_SEGMENT_SIZE;
+    segment->context.uc_link = &segment->caller;
+    makecontext(&segment->context, runPending, 0);
+    pendingFunction = function;
+    pendingArgument = argument;
+    // comes back here through uc_link once runPending returns
+    swapcontext(&segment->caller, &segment->context);
+    stackUnwind(segmentsInUse - 1);
+}
+
+// Returns the number of segments in use, to be handed to stackUnwind
+size_t stackSegmentDepth()
+{
+    return segmentsInUse;
+}
+
+// Takes a number of segments returned by stackSegmentDepth and goes back to
+// the segment that was in use then
+void stackUnwind(size_t depth)
+{
+    while (segmentsInUse > depth)
+    {
+        stackTop = current->savedTop;
+        stackLimit = current->savedLimit;
+        stackMark = current->savedMark;
+        usedBelow = current->savedBelow;
+        current = current->shallower;
+        segmentsInUse--;
+    }
+
+    // the segment below the one in use is kept, so that recursion going back
+    // and forth across a boundary does not allocate each time
+    Segment *spare = current == NULL ? segments : current->deeper;
+    if (spare != NULL)
+    {
+        Segment *unused = spare->deeper;
+        spare->deeper = NULL;
+        while (unused != NULL)
+        {
+            Segment *next = unused->deeper;
+            free(unused);
+            unused = next;
+        }
+    }
+}
+
+// Prints the deepest the evaluator's stack got and the number of segments it
+// used to stderr.
+void stackPrintStats()
+{
+    fprintf(stderr, "stack peak depth:     %zu bytes\n", peakDepth);
+    fprintf(stderr, "stack segments used:  %zu\n", peakSegments);
+}
@@ -0,0 +1,59 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef STACK_H
+#define STACK_H
+
+// The tree-walking evaluator recurses on the C stack, once or twice for every
+// call that is not in tail position. To keep deep recursion from overflowing
+// it, applyLambda checks how much is left before every call, since every
+// unbounded recursion goes through it. When the current stack is nearly used
+// up, the call is moved onto a new segment of stack allocated from the heap,
+// and the evaluator moves back once it returns. Recursion depth is then
+// bounded only by memory. The reader, which recurses once for every level of
+// nesting in a datum, checks the same way before every nested list.
+// Once the evaluator has come back out of them, one segment is kept for the
+// next deep call and any deeper ones are freed.
+
+// The address below which the current stack needs checking: either the
+// point where it is nearly used up, or the deepest point recorded so far
+extern char *stackMark;
+
+// Takes the address of a local variable in a function that is about to go
+// deeper, records how deep the stack has got, and returns whether the current
+// segment is nearly used up
+bool stackCheck(char *position);
+
+// The address of the calling function's frame. Taking the address of a local
+// instead would keep it in memory, and slow down the functions that check.
+#ifdef __GNUC__
+#define STACK_POSITION() ((char *)__builtin_frame_address(0))
+#else
+#define STACK_POSITION() ((char *)&(char){0})
+#endif
+
+// Returns whether a new segment is needed before going any deeper. Only a
+// comparison unless the stack is deeper than it has been before.
+#define stackNearlyFull() (STACK_POSITION() < stackMark && stackCheck(STACK_POSITION()))
+
+// Takes a function and an argument for it, and calls it on a new segment of
+// stack, returning once it has returned
+void stackRunOnNewSegment(void (*function)(void *argument), void *argument);
+
+// Returns the number of segments in use, to be handed to stackUnwind
+size_t stackSegmentDepth();
+
+// Takes a number of segments returned by stackSegmentDepth and goes back to
+// the segment that was in use then. Only needed after a longjmp out of
+// deeper segments, which never return to the segments above them.
+void stackUnwind(size_t depth);
+
+// Takes the address of a local variable in main and records where the stack
+// starts and how far it may grow.
+void stackInit(char *base);
+
+// Prints the deepest the evaluator's stack got and the number of segments it
+// used to stderr.
+void stackPrintStats();
+
+#endif
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include "item.h"
+#include "talloc.h"
+#include "gc.h"
+#include "symbols.h"
+
+// Interned symbols are kept in an open-addressing hash table that is doubled
+// whenever it gets half full. Symbols are never collected, so the table does
+// not need to be a root.
+#define INITIAL_CAPACITY 256
+
+// The name of every special form, indexed by its formId
+static char *formNames[] = {NULL, "if", "let", "display", "newline", "let*",
+                            "letrec", "quote", "define", "lambda", "set!",
+                            "set-car!", "set-cdr!", "and", "or", "cond"};
+#define FORM_COUNT (sizeof(formNames) / sizeof(formNames[0]))
+
+static Item **table = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+
+// Takes a name and its length and returns its FNV-1a hash
+static size_t hashName(char *name, size_t length)
+{
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Takes a table, its capacity and a name and its length, and returns the slot
+// where the name either is or should go
+static Item **findSlot(Item **slots, size_t size, char *name, size_t length)
+{
+    size_t i = hashName(name, length) & (size - 1);
+    while (slots[i] != NULL && (strncmp(slots[i]->s, name, length) != 0 || slots[i]->s[length] != '\0'))
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return &slots[i];
+}
+
+// Moves every symbol into a table twice the size. The old table is left
+// behind in the talloc arena.
+static void grow()
+{
+    size_t newCapacity = capacity == 0 ? INITIAL_CAPACITY : capacity * 2;
+    Item **newTable = talloc(newCapacity * sizeof(Item *));
+    memset(newTable, 0, newCapacity * sizeof(Item *));
+    for (size_t i = 0; i < capacity; i++)
+    {
+        if (table[i] != NULL)
+        {
+            *findSlot(newTable, newCapacity, table[i]->s, strlen(table[i]->s)) = table[i];
+        }
+    }
+    table = newTable;
+    capacity = newCapacity;
+}
+
+// Takes a name that need not be null-terminated and its length, and returns
+// the one SYMBOL_TYPE item with that name, creating it the first time the name
+// is seen. Only then is the name copied.
+Item *internLength(char *name, size_t length)
+{
+    if ((count + 1) * 2 > capacity)
+    {
+        grow();
+    }
+
+    Item **slot = findSlot(table, capacity, name, length);
+    if (*slot == NULL)
+    {
+        Item *symbol = gcPermanentItem();
+        symbol->type = SYMBOL_TYPE;
+        symbol->s = talloc(length + 1);
+        memcpy(symbol->s, name, length);
+        symbol->s[length] = '\0';
+        symbol->sym.form = FORM_NONE;
+        for (size_t form = FORM_NONE + 1; form < FORM_COUNT; form++)
+        {
+            if (!strcmp(symbol->s, formNames[form]))
+            {
+                symbol->sym.form = form;
+            }
+        }
+        *slot = symbol;
+        count++;
+    }
+    return *slot;
+}
+
+// Takes the name of a symbol and returns the one SYMBOL_TYPE item with that
+// name, creating it the first time the name is seen.
+Item *intern(char *name)
+{
+    return internLength(name, strlen(name));
+}
@@ -0,0 +1,47 @@
+#include <stddef.h>
+#include "item.h"
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+// The special forms. Every symbol is given its form when it is interned, so
+// eval can dispatch on a symbol with a single switch. Symbols that do not
+// name a special form are FORM_NONE.
+typedef enum
+{
+    FORM_NONE,
+    FORM_IF,
+    FORM_LET,
+    FORM_DISPLAY,
+    FORM_NEWLINE,
+    FORM_LET_STAR,
+    FORM_LETREC,
+    FORM_QUOTE,
+    FORM_DEFINE,
+    FORM_LAMBDA,
+    FORM_SET,
+    FORM_SET_CAR,
+    FORM_SET_CDR,
+    FORM_AND,
+    FORM_OR,
+    FORM_COND
+} formId;
+
+// Takes an item and returns the special form it names, or FORM_NONE if it is
+// not a symbol naming one
+static inline formId formOf(Item *item)
+{
+    return typeOf(item) == SYMBOL_TYPE ? (formId)item->sym.form : FORM_NONE;
+}
+
+// Takes the name of a symbol and returns the one SYMBOL_TYPE item with that
+// name, creating it the first time the name is seen. Since every symbol is
+// interned, two symbols are the same symbol exactly when they are the same
+// pointer.
+Item *intern(char *name);
+
+// Takes a name that need not be null-terminated and its length, and returns
+// the symbol with that name, as intern does.
+Item *internLength(char *name, size_t length);
+
+#endif
@@ -1,67 +1,90 @@
 #include <stdlib.h>
+#include <stddef.h>
 #include "item.h"
 #include <stdio.h>
 
 #ifndef TALLOC_H
 #define TALLOC_H
 
-// Replacement for malloc that stores the pointers allocated. It should store
-// the pointers in some kind of list; a linked list would do fine, but insert
-// here whatever code you'll need to do so; don't call functions in the
-// pre-existing linkedlist.h. Otherwise you'll end up with circular
-// dependencies, since you're going to modify the linked list to use talloc.
-int iniitalized = 0;
-Item *head;
+// Memory handed out by talloc is carved out of large slabs with a bump
+// pointer. Nothing is released individually; tfree hands every slab back to
+// the system at once, so teardown costs one free per slab rather than one per
+// allocation.
+#define SLAB_SIZE (1 << 20)
+#define TALLOC_ALIGN (sizeof(max_align_t))
 
-// Takes a car and cdr and creates a cons type item node with the car and cdr.
-Item *local_cons(Item *newCar, Item *newCdr)
+typedef struct Slab
 {
-    Item *item = malloc(sizeof(Item));
-    item->type = CONS_TYPE;
-    item->c.car = newCar;
-    item->c.cdr = newCdr;
-    return item;
+    struct Slab *next;
+    size_t used;
+    size_t capacity;
+    max_align_t data[];
+} Slab;
+
+// The slab currently being bumped into. Every other slab hangs off its next
+// pointer.
+static Slab *slabs = NULL;
+
+// Takes a capacity in bytes and returns a new empty slab able to hold it.
+// Exits if the system is out of memory.
+static Slab *newSlab(size_t capacity)
+{
+    Slab *slab = malloc(sizeof(Slab) + capacity);
+    if (slab == NULL)
+    {
+        printf("Out of memory\n");
+        exit(1);
+    }
+    slab->next = NULL;
+    slab->used = 0;
+    slab->capacity = capacity;
+    return slab;
 }
 
 // Identical to malloc, takes a size and returns a pointer to allocated memory of that size with the difference it has an underlying garbage collector to free memory after execution
 void *talloc(size_t size)
 {
-    if (!iniitalized)
+    size = (size + TALLOC_ALIGN - 1) & ~(TALLOC_ALIGN - 1);
+
+    if (slabs == NULL || slabs->capacity - slabs->used < size)
     {
-        iniitalized = 1;
-        head = malloc(sizeof(Item));
-        head->type = CONS_TYPE;
-        Item *item = malloc(sizeof(Item));
-        item->type = NULL_TYPE;
-        head->c.cdr = item;
-        head->c.car = NULL;
+        if (size > SLAB_SIZE / 4)
+        {
+            // Big requests get a slab of their own, tucked behind the current
+            // one so the space left in it is not thrown away.
+            Slab *slab = newSlab(size);
+            slab->used = size;
+            if (slabs == NULL)
+            {
+                slabs = slab;
+            }
+            else
+            {
+                slab->next = slabs->next;
+                slabs->next = slab;
+            }
+            return slab->data;
+        }
+        Slab *slab = newSlab(SLAB_SIZE);
+        slab->next = slabs;
+        slabs = slab;
     }
-    Item *item = malloc(sizeof(Item));
-    item->type = PTR_TYPE;
-    item->p = malloc(size);
-    head = local_cons(item, head);
-    return item->p;
+
+    void *p = (char *)slabs->data + slabs->used;
+    slabs->used += size;
+    return p;
 }
 
-// Free all pointers allocated by talloc, as well as whatever memory you
-// allocated in lists to hold those pointers.
+// Free all slabs allocated by talloc, which releases every pointer it has
+// handed out.
 void tfree()
 {
-    int i = 0;
-    while (head != NULL && head->type != NULL_TYPE)
+    while (slabs != NULL)
     {
-        i++;
-        if (head->c.car != NULL)
-        {
-            free(head->c.car->p);
-            free(head->c.car);
-        }
-        Item *temp = head->c.cdr;
-        free(head);
-        head = temp;
+        Slab *next = slabs->next;
+        free(slabs);
+        slabs = next;
     }
-    free(head);
-    iniitalized = 0;
 }
 
 // Takes a status code and frees the allocated memory before exiting with the status code given
@@ -4,15 +4,14 @@
 #ifndef TALLOC_H
 #define TALLOC_H
 
-// Replacement for malloc that stores the pointers allocated. It should store
-// the pointers in some kind of list; a linked list would do fine, but insert
-// here whatever code you'll need to do so; don't call functions in the
-// pre-existing linkedlist.h. Otherwise you'll end up with circular
-// dependencies, since you're going to modify the linked list to use talloc.
+// Replacement for malloc. Allocations are bumped out of large slabs, so
+// individual pointers are never freed; they all go away together in tfree.
+// Don't call functions in linkedlist.h from here, since the linked list is
+// itself built on talloc.
 void *talloc(size_t size);
 
-// Free all pointers allocated by talloc, as well as whatever memory you
-// allocated in lists to hold those pointers.
+// Free every slab allocated by talloc, which releases all pointers it has
+// handed out.
 void tfree();
 
 // Replacement for the C function "exit", that consists of two lines: it calls
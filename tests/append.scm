@@ -0,0 +1,9 @@
+; append copies the pairs of its first list and shares everything else, so
+; symbols and nested lists come out as they went in, and the original list is
+; left alone
+(append (quote (a b)) (quote (c)))
+(append (quote ((a 1) b)) (quote (c)))
+(append (quote ("s" 2.5 #t)) 5)
+(define l (quote (x (y))))
+(append l l)
+l
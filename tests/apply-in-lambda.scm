@@ -0,0 +1,7 @@
+; applying a list inside a procedure body is an error too, in tail position
+; or not
+(define l (quote (1 2)))
+(define f (lambda (n) (if (= n 0) (l n) (+ 1 (f (- n 1))))))
+(quote before)
+(f 3)
+(quote after)
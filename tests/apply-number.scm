@@ -0,0 +1,4 @@
+; applying a number is an error, once the arguments have been evaluated
+(quote before)
+(1 (display 2))
+(quote after)
@@ -0,0 +1,4 @@
+; applying a string is an error
+(quote before)
+("a" 1)
+(quote after)
@@ -0,0 +1,5 @@
+; applying a variable that holds a number is an error
+(define x 5)
+(quote before)
+(x 1)
+(quote after)
@@ -0,0 +1,23 @@
+; call/cc used to escape, which both evaluators support however deep the
+; escape is
+(call/cc (lambda (k) 1))
+(call/cc (lambda (k) (k 2) 3))
+(+ 1 (call/cc (lambda (k) (+ 10 (k 5)))))
+(define find
+  (lambda (pred l)
+    (call-with-current-continuation
+     (lambda (return)
+       (define walk
+         (lambda (l)
+           (if (null? l)
+               #f
+               (if (pred (car l))
+                   (return (car l))
+                   (walk (cdr l))))))
+       (walk l)))))
+(find (lambda (x) (> x 3)) (quote (1 2 3 4 5)))
+(find (lambda (x) (> x 9)) (quote (1 2 3 4 5)))
+(define deep (lambda (n k) (if (= n 0) (k 42) (+ 1 (deep (- n 1) k)))))
+(call/cc (lambda (k) (deep 100000 k)))
+(call/cc (lambda (outer) (+ 1 (call/cc (lambda (inner) (outer 7))))))
+(call/cc (lambda (outer) (+ 1 (call/cc (lambda (inner) (inner 7))))))
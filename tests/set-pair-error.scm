@@ -0,0 +1,5 @@
+; set-car! on something that is not a pair is an error, once the pair and the
+; value have been evaluated
+(quote before)
+(set-car! (car (cons 5 6)) (display 1))
+(quote after)
@@ -0,0 +1,13 @@
+; set-car! and set-cdr! take any expression that gives a pair, not only a
+; variable, and change that pair in place
+(define x (cons 1 (cons 2 (cons 3 (quote ())))))
+(set-car! (cdr x) 20)
+(set-cdr! (cdr (cdr x)) (cons 4 (quote ())))
+x
+(define rest (lambda (l) (cdr l)))
+(set-car! (rest (rest x)) 30)
+x
+(define first! (lambda (l value) (set-car! l value) l))
+(first! x 10)
+(first! (rest x) (quote b))
+x
@@ -0,0 +1,36 @@
+; Thousands of call/cc open inside one another. Returning through them, and
+; escaping past all of them at once, copies each call's part of the stack at
+; most once, so these take about as long as the recursion itself. Calling one
+; of the deep continuations again afterwards still works.
+(define loop
+  (lambda (n)
+    (if (= n 0)
+        0
+        (+ 1 (call/cc (lambda (k) (loop (- n 1))))))))
+(loop 20000)
+
+(define escape
+  (lambda (n k)
+    (if (= n 0)
+        (k (quote escaped))
+        (+ 1 (call/cc (lambda (j) (escape (- n 1) k)))))))
+(call/cc (lambda (k) (escape 20000 k)))
+
+(define again
+  (lambda (n)
+    (define ks (quote ()))
+    (define rounds 0)
+    (define nest
+      (lambda (n)
+        (if (= n 0)
+            0
+            (+ 1 (call/cc (lambda (k) (set! ks (cons k ks)) (nest (- n 1))))))))
+    (define nth
+      (lambda (l i)
+        (if (= i 0) (car l) (nth (cdr l) (- i 1)))))
+    (define total (nest n))
+    (set! rounds (+ rounds 1))
+    (if (< rounds 3)
+        ((nth ks (* rounds 1000)) 100)
+        total)))
+(again 20000)
@@ -0,0 +1,36 @@
+; A generator that hands out the elements of a list one at a time, by jumping
+; back into the middle of its walk over the list whenever it is asked for the
+; next one. Calling a continuation again once its call/cc has returned needs
+; the VM.
+(define make-generator
+  (lambda (l)
+    (define return #f)
+    (define resume #f)
+    (define walk
+      (lambda (l)
+        (if (null? l)
+            (return (quote done))
+            (let ((ignored (call/cc (lambda (k) (set! resume k) (return (car l))))))
+              (walk (cdr l))))))
+    (lambda ()
+      (call/cc
+       (lambda (k)
+         (set! return k)
+         (if resume
+             (resume #f)
+             (walk l)))))))
+
+(define next (make-generator (quote (1 (2 3) "four"))))
+(next)
+(next)
+(next)
+(next)
+(next)
+
+; two generators at once each keep their own place
+(define a (make-generator (quote (a1 a2))))
+(define b (make-generator (quote (b1 b2))))
+(a)
+(b)
+(a)
+(b)
@@ -1,258 +1,506 @@
 #include "tokenizer.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
 #include "talloc.h"
+#include "gc.h"
 #include "linkedlist.h"
+#include "symbols.h"
+#include "bignum.h"
 #include "string.h"
 
 #ifndef ITEM_H
 #define ITEM
 #endif
 
-// checks if a character is a special character
-bool isspecial(char x)
+// How much input is read from a stream at a time
+#define BLOCK_SIZE (1 << 16)
+
+// Runs of whitespace and the characters of a symbol are scanned a vector at a
+// time where the compiler offers one: 32 bytes with AVX2 (build with -mavx2),
+// 16 with SSE2, which every x86-64 has, and a byte at a time otherwise.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VECTOR_SIZE 32
+typedef __m256i vector;
+#define loadVector(p) _mm256_loadu_si256((const __m256i *)(p))
+#define splat(c) _mm256_set1_epi8(c)
+#define equal(a, b) _mm256_cmpeq_epi8(a, b)
+#define either(a, b) _mm256_or_si256(a, b)
+#define maskOf(v) ((uint32_t)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VECTOR_SIZE 16
+typedef __m128i vector;
+#define loadVector(p) _mm_loadu_si128((const __m128i *)(p))
+#define splat(c) _mm_set1_epi8(c)
+#define equal(a, b) _mm_cmpeq_epi8(a, b)
+#define either(a, b) _mm_or_si128(a, b)
+#define maskOf(v) ((uint32_t)_mm_movemask_epi8(v))
+#endif
+
+// What part each character can play, as bits in charClasses
+#define CLASS_DIGIT 1
+#define CLASS_LETTER 2
+// a symbol all on its own
+#define CLASS_SPECIAL 4
+// skipped between tokens
+#define CLASS_SPACE 8
+// ends a symbol
+#define CLASS_DELIMITER 16
+
+static unsigned char charClasses[256];
+
+// The input is read in blocks into one buffer and scanned with a pointer.
+// Everything from tokenStart on is kept when the next block is read, sliding it
+// to the front of the buffer (or into a bigger one), so a token is always
+// contiguous however it falls across blocks, and the buffer only has to be as
+// big as the longest token plus a block.
+//
+// A source file named on the command line is mapped into memory whole
+// instead, and never refilled. Its text stays put until the program exits, so
+// tokens can point straight into it rather than being copied out.
+static FILE *input = NULL;
+static bool mapped = false;
+static char *buffer = NULL;
+static size_t capacity = 0;
+static char *tokenStart = NULL;
+static char *position = NULL;
+static char *limit = NULL;
+
+// A reusable buffer for the text of a token that has to be null-terminated
+static char *scratch = NULL;
+static size_t scratchCapacity = 0;
+
+static size_t bytesRead = 0;
+static size_t tokensRead = 0;
+
+// Parentheses and brackets carry nothing but their type, so every one of them
+// is the same item
+static Item openToken = {.type = OPEN_TYPE, .s = "("};
+static Item closeToken = {.type = CLOSE_TYPE, .s = ")"};
+static Item openBracketToken = {.type = OPENBRACKET_TYPE, .s = "["};
+static Item closeBracketToken = {.type = CLOSEBRACKET_TYPE, .s = "]"};
+
+// Reads the next block of the input after the characters still in the buffer,
+// keeping everything from tokenStart on. Returns false at the end of the input.
+static bool refill()
+{
+    if (mapped)
+    {
+        return false;
+    }
+    size_t kept = limit - tokenStart;
+    size_t scanned = position - tokenStart;
+    if (kept + BLOCK_SIZE > capacity)
+    {
+        size_t newCapacity = capacity ? capacity * 2 : 4 * BLOCK_SIZE;
+        while (kept + BLOCK_SIZE > newCapacity)
+        {
+            newCapacity *= 2;
+        }
+        char *newBuffer = malloc(newCapacity);
+        if (newBuffer == NULL)
+        {
+            printf("Out of memory reading input\n");
+            texit(1);
+        }
+        memcpy(newBuffer, tokenStart, kept);
+        free(buffer);
+        buffer = newBuffer;
+        capacity = newCapacity;
+    }
+    else
+    {
+        memmove(buffer, tokenStart, kept);
+    }
+    tokenStart = buffer;
+    position = buffer + scanned;
+    limit = buffer + kept;
+
+    FILE *stream = input ? input : stdin;
+    size_t count = fread(limit, 1, BLOCK_SIZE, stream);
+    if (count == 0 && ferror(stream))
+    {
+        printf("Could not read the input\n");
+        texit(1);
+    }
+    limit += count;
+    bytesRead += count;
+    return count > 0;
+}
+
+// Returns the next character without consuming it, or EOF at the end of the
+// input
+static inline int peek()
+{
+    if (position == limit && !refill())
+    {
+        return EOF;
+    }
+    return (unsigned char)*position;
+}
+
+// Fills in the class of every character
+static void initClasses()
 {
-    char *specials = "!$%&*/:<=>?~_^";
+    for (int c = '0'; c <= '9'; c++)
+    {
+        charClasses[c] |= CLASS_DIGIT;
+    }
+    for (int c = 'a'; c <= 'z'; c++)
+    {
+        charClasses[c] |= CLASS_LETTER;
+        charClasses[c - 'a' + 'A'] |= CLASS_LETTER;
+    }
+    for (char *special = "!$%&*/:<=>?~_^"; *special != '\0'; special++)
+    {
+        charClasses[(unsigned char)*special] |= CLASS_SPECIAL;
+    }
+    for (char *space = " \n"; *space != '\0'; space++)
+    {
+        charClasses[(unsigned char)*space] |= CLASS_SPACE | CLASS_DELIMITER;
+    }
+    for (char *delimiter = "()]"; *delimiter != '\0'; delimiter++)
+    {
+        charClasses[(unsigned char)*delimiter] |= CLASS_DELIMITER;
+    }
+}
 
-    while (*specials != '\0')
+// Returns true if the character, which may be EOF, has the given class
+static inline bool hasClass(int c, int charClass)
+{
+    return c != EOF && (charClasses[c] & charClass);
+}
+
+// Takes the start and end of some text in the buffer and returns a pointer to
+// its first character that is not a space or newline, or the end
+static char *findNonSpace(char *p, char *end)
+{
+#ifdef VECTOR_SIZE
+    while (end - p >= VECTOR_SIZE)
     {
-        if (*specials == x)
+        vector text = loadVector(p);
+        uint32_t spaces = maskOf(either(equal(text, splat(' ')), equal(text, splat('\n'))));
+        uint32_t others = ~spaces & (uint32_t)((1ull << VECTOR_SIZE) - 1);
+        if (others != 0)
         {
-            return true;
+            return p + __builtin_ctz(others);
         }
-        specials++;
+        p += VECTOR_SIZE;
+    }
+#endif
+    while (p < end && (charClasses[(unsigned char)*p] & CLASS_SPACE))
+    {
+        p++;
     }
-    return false;
+    return p;
 }
 
-// Takes input from stdin and returns a linkedlist that contains the tokens
-Item *tokenize()
+// Takes the start and end of some text in the buffer and returns a pointer to
+// its first character that ends a symbol, or the end
+static char *findDelimiter(char *p, char *end)
 {
-    char charRead;
-    Item *list = makeNull();
-    charRead = (char)fgetc(stdin);
-    while (charRead != EOF)
+#ifdef VECTOR_SIZE
+    while (end - p >= VECTOR_SIZE)
     {
-        if (charRead == ' ' || charRead == '\n')
+        vector text = loadVector(p);
+        vector spaces = either(equal(text, splat(' ')), equal(text, splat('\n')));
+        vector parens = either(equal(text, splat('(')), equal(text, splat(')')));
+        uint32_t delimiters = maskOf(either(either(spaces, parens), equal(text, splat(']'))));
+        if (delimiters != 0)
         {
-            charRead = (char)fgetc(stdin);
-            continue;
+            return p + __builtin_ctz(delimiters);
         }
-        else if (charRead == '(')
+        p += VECTOR_SIZE;
+    }
+#endif
+    while (p < end && !(charClasses[(unsigned char)*p] & CLASS_DELIMITER))
+    {
+        p++;
+    }
+    return p;
+}
+
+// Consumes a run of spaces and newlines, letting go of them as it reads more
+// input, since they are not part of any token
+static void skipSpaces()
+{
+    while ((position = findNonSpace(position, limit)) == limit)
+    {
+        tokenStart = position;
+        if (!refill())
         {
-            Item *item = talloc(sizeof(Item));
-            item->type = OPEN_TYPE;
-            item->s = "(";
-            list = cons(item, list);
-            charRead = fgetc(stdin);
-            continue;
+            return;
         }
+    }
+}
 
-        else if (charRead == ')')
+// Consumes the rest of a symbol, up to the character that ends it
+static void skipSymbol()
+{
+    while ((position = findDelimiter(position, limit)) == limit)
+    {
+        if (!refill())
         {
-            Item *item = talloc(sizeof(Item));
-            item->type = CLOSE_TYPE;
-            item->s = ")";
-            list = cons(item, list);
-            charRead = fgetc(stdin);
+            return;
+        }
+    }
+}
 
-            continue;
+// Consumes characters up to the next c, if there is one, or else the rest of
+// the input
+static void skipUntil(char c)
+{
+    char *found;
+    while ((found = memchr(position, c, limit - position)) == NULL)
+    {
+        position = limit;
+        if (!refill())
+        {
+            return;
         }
+    }
+    position = found;
+}
+
+// Consumes a run of decimal digits
+static void skipDigits()
+{
+    while (hasClass(peek(), CLASS_DIGIT))
+    {
+        position++;
+    }
+}
+
+// Takes the path of a source file and makes the tokenizer read it instead of
+// stdin. A regular file is mapped into memory; a pipe, terminal or socket is read
+// like stdin. Anything else, such as a directory, is an error.
+void tokenizerOpen(char *path)
+{
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0)
+    {
+        printf("Could not open %s\n", path);
+        texit(1);
+    }
 
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        printf("Could not open %s\n", path);
+        texit(1);
+    }
+    if (!S_ISREG(status.st_mode) && !S_ISFIFO(status.st_mode) && !S_ISCHR(status.st_mode) && !S_ISSOCK(status.st_mode))
+    {
+        printf("Could not open %s: it is neither a file nor a stream\n", path);
+        texit(1);
+    }
+    if (S_ISREG(status.st_mode))
+    {
+        char *text = NULL;
+        if (status.st_size > 0)
+        {
+            text = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        }
+        if (text != MAP_FAILED)
+        {
+            // the mapping outlives the descriptor
+            close(descriptor);
+            mapped = true;
+            buffer = tokenStart = position = text;
+            limit = text + status.st_size;
+            bytesRead = status.st_size;
+            return;
+        }
+    }
+
+    input = fdopen(descriptor, "r");
+    if (input == NULL)
+    {
+        printf("Could not open %s\n", path);
+        texit(1);
+    }
+}
+
+// Takes a number of characters to leave off the front of the token being
+// scanned, and returns a null-terminated copy of the rest of it up to the
+// current position. The copy is only good until the next call.
+static char *copyToken(size_t skip)
+{
+    char *from = tokenStart + skip;
+    size_t length = position - from;
+    if (length + 1 > scratchCapacity)
+    {
+        scratchCapacity = (length + 1) * 2;
+        free(scratch);
+        scratch = malloc(scratchCapacity);
+    }
+    memcpy(scratch, from, length);
+    scratch[length] = '\0';
+    return scratch;
+}
+
+// Takes a token that has just been read, counts it and returns it
+static Item *countToken(Item *token)
+{
+    tokensRead++;
+    return token;
+}
+
+// Takes whether the token being scanned started with a minus sign, scans a
+// number whose digits start at the current position, and returns it as an
+// integer, or as a double if it has a fractional part
+static Item *readNumber(bool negative)
+{
+    size_t sign = position - tokenStart;
+    skipDigits();
+    if (peek() == '.')
+    {
+        position++;
+        skipDigits();
+        Item *item = gcItem();
+        item->type = DOUBLE_TYPE;
+        item->d = strtold(copyToken(sign), NULL);
+        if (negative)
+        {
+            item->d = -item->d;
+        }
+        return item;
+    }
+
+    // too many digits for an int makes a bignum
+    return integerParse(tokenStart + sign, position - tokenStart - sign, negative);
+}
+
+// Reads the next token from the input and returns it, or NULL at the end of
+// the input
+Item *readToken()
+{
+    if (!(charClasses['0'] & CLASS_DIGIT))
+    {
+        initClasses();
+    }
+    while (true)
+    {
+        tokenStart = position;
+        int charRead = peek();
+        if (charRead == EOF)
+        {
+            return NULL;
+        }
+        position++;
+
+        if (charClasses[charRead] & CLASS_SPACE)
+        {
+            skipSpaces();
+            continue;
+        }
+        else if (charRead == '(')
+        {
+            return countToken(&openToken);
+        }
+        else if (charRead == ')')
+        {
+            return countToken(&closeToken);
+        }
         else if (charRead == '-' || charRead == '+')
         {
-            char sign = charRead;
-            char potentialdigit = fgetc(stdin);
-            if ((potentialdigit >= '9' || potentialdigit <= '0') && charRead != EOF)
+            // a sign only starts a number when a digit from 1 to 8 follows it
+            int potentialdigit = peek();
+            if (potentialdigit >= '9' || potentialdigit <= '0')
             {
-                Item *item = talloc(sizeof(Item));
-                item->type = SYMBOL_TYPE;
-                item->s = (charRead == '-') ? "-" : "+";
-                list = cons(item, list);
-                ungetc(potentialdigit, stdin);
+                Item *item = intern((charRead == '-') ? "-" : "+");
+                return countToken(item);
             }
             else
             {
-                ungetc(potentialdigit, stdin);
-                char buffer[300] = "";
-                int i = 0;
-                charRead = (char)fgetc(stdin);
-                while (charRead <= '9' && charRead >= '0' && charRead != EOF)
-                {
-                    buffer[i] = charRead;
-                    i++;
-                    charRead = (char)fgetc(stdin);
-                }
-                if (charRead == '.')
-                {
-                    buffer[i] = charRead;
-                    i++;
-                    charRead = fgetc(stdin);
-                    while (charRead <= '9' && charRead >= '0')
-                    {
-                        buffer[i] = charRead;
-                        i++;
-                        charRead = fgetc(stdin);
-                    }
-                    buffer[i + 1] = '\0';
-                    // ungetc(charRead, stdin);
-                    Item *item = talloc(sizeof(Item));
-                    item->type = DOUBLE_TYPE;
-                    if (sign == '-')
-                    {
-                        item->d = -strtold(buffer, NULL);
-                    }
-                    else
-                    {
-                        item->d = strtold(buffer, NULL);
-                    }
-
-                    list = cons(item, list);
-                    continue;
-                }
-
-                ungetc(charRead, stdin);
-
-                Item *item = talloc(sizeof(Item));
-
-                item->type = INT_TYPE;
-                if (sign == '-')
-                {
-                    item->i = -strtol(buffer, NULL, 10);
-                }
-                else
-                {
-                    item->i = strtol(buffer, NULL, 10);
-                }
-
-                list = cons(item, list);
-                // continue;
+                return countToken(readNumber(charRead == '-'));
             }
         }
         else if (charRead == '.')
         {
-            char buffer[300];
-            int i = 0;
-            buffer[i] = charRead;
-            i++;
-            charRead = (char)fgetc(stdin);
-            while (charRead <= '9' && charRead >= '0')
-            {
-                buffer[i] = charRead;
-                i++;
-                charRead = (char)fgetc(stdin);
-            }
-            Item *item = talloc(sizeof(Item));
+            skipDigits();
+            Item *item = gcItem();
             item->type = DOUBLE_TYPE;
-            item->d = strtold(buffer, NULL);
-            list = cons(item, list);
-            continue;
+            item->d = strtold(copyToken(0), NULL);
+            return countToken(item);
         }
         else if (charRead == '[')
         {
-            Item *item = talloc(sizeof(Item));
-            item->type = OPENBRACKET_TYPE;
-            item->s = "[";
-            list = cons(item, list);
+            return countToken(&openBracketToken);
         }
         else if (charRead == ']')
         {
-            Item *item = talloc(sizeof(Item));
-            item->type = CLOSEBRACKET_TYPE;
-            item->s = "]";
-            list = cons(item, list);
+            return countToken(&closeBracketToken);
         }
-
         else if (charRead == '\"')
         {
-            char buffer[300] = "";
-            int i = 0;
-            buffer[i] = charRead;
-            i++;
-            charRead = fgetc(stdin);
-            while (charRead != '\"' && charRead != EOF)
+            skipUntil('\"');
+            int c = peek();
+            Item *item = gcItem();
+            item->type = STR_TYPE;
+            if (mapped && c != EOF)
             {
-                buffer[i] = charRead;
-                charRead = fgetc(stdin);
-                i++;
+                position++;
+                item->str.chars = tokenStart;
+                item->str.length = position - tokenStart;
             }
-            buffer[i] = '\"';
-            buffer[i + 1] = '\0';
-            Item *item = talloc(sizeof(Item));
-            item->type = STR_TYPE;
-            item->s = talloc(sizeof(buffer));
-            strcpy(item->s, buffer);
-            list = cons(item, list);
-        }
-
-        else if (charRead == ';')
-        {
-            char nextChar = fgetc(stdin);
+            else
             {
-                while (true)
+                // the buffer is about to be reused, and a string that runs
+                // to the end of the input still gets its closing quote
+                int length = position - tokenStart;
+                if (c != EOF)
                 {
-                    charRead = fgetc(stdin);
-                    if (charRead == '\n' || charRead == EOF)
-                        break;
+                    position++;
                 }
+                item->str.chars = gcData(length + 1);
+                memcpy(item->str.chars, tokenStart, length);
+                item->str.chars[length] = '\"';
+                item->str.length = length + 1;
+                item->str.collected = true;
             }
+            return countToken(item);
         }
-
-        else if (charRead <= '9' && charRead >= '0')
+        else if (charRead == ';')
         {
-            char buffer[300] = "";
-            int i = 0;
-
-            while (charRead <= '9' && charRead >= '0')
+            // the character after the semicolon is skipped before looking for
+            // the end of the line
+            if (peek() != EOF)
             {
-                buffer[i] = charRead;
-                i++;
-                charRead = (char)fgetc(stdin);
+                position++;
             }
-
-            if (charRead == '.')
+            tokenStart = position;
+            skipUntil('\n');
+            if (peek() != EOF)
             {
-                buffer[i] = charRead;
-                i++;
-                charRead = (char)fgetc(stdin);
-                while (charRead <= '9' && charRead >= '0')
-                {
-                    buffer[i] = charRead;
-                    i++;
-                    charRead = (char)fgetc(stdin);
-                }
-                Item *item = talloc(sizeof(Item));
-                item->type = DOUBLE_TYPE;
-                item->d = strtold(buffer, NULL);
-                list = cons(item, list);
-
-                continue;
+                position++;
             }
-
-            ungetc(charRead, stdin);
-
-            Item *item = talloc(sizeof(Item));
-            item->type = INT_TYPE;
-            item->i = strtol(buffer, NULL, 10);
-            list = cons(item, list);
+        }
+        else if (charClasses[charRead] & CLASS_DIGIT)
+        {
+            position--;
+            return countToken(readNumber(false));
         }
         else if (charRead == '#')
         {
-            charRead = fgetc(stdin);
+            charRead = peek();
+            if (charRead != EOF)
+            {
+                position++;
+            }
             if (charRead == 'f')
             {
-                Item *item = talloc(sizeof(Item));
-                item->type = BOOL_TYPE;
-                // item->s = talloc((3));
-                item->s = "#f";
-                list = cons(item, list);
+                return countToken(FALSE_ITEM);
             }
             else if (charRead == 't')
             {
-                Item *item = talloc(sizeof(Item));
-                item->type = BOOL_TYPE;
-                item->s = "#t";
-                list = cons(item, list);
+                return countToken(TRUE_ITEM);
             }
             else
             {
@@ -260,57 +508,58 @@ Item *tokenize()
                 texit(1);
             }
         }
-        else if (isspecial(charRead))
+        else if (charClasses[charRead] & CLASS_SPECIAL)
         {
-            Item *item = talloc(sizeof(Item));
-            item->type = SYMBOL_TYPE;
-            item->s = talloc(2);
-            item->s[0] = charRead;
-            item->s[1] = '\0';
-            list = cons(item, list);
+            char name[2] = {charRead, '\0'};
+            Item *item = intern(name);
+            return countToken(item);
         }
-
         else
         {
-            if (!isspecial(charRead) && !(charRead >= 'a' && charRead <= 'z') && !(charRead >= 'A' && charRead <= 'Z'))
+            if (!(charClasses[charRead] & CLASS_LETTER))
             {
                 printf("Syntax error (readSymbol): symbol %c does not start with an allowed first character.\n", charRead);
                 texit(1);
             }
-            char buffer[300] = "";
-            int i = 0;
-            buffer[i] = charRead;
-            i++;
-            charRead = fgetc(stdin);
-            while (charRead != ']' && charRead != ']' && charRead != '(' && charRead != EOF && charRead != ' ' && charRead != '\n' && charRead != ')')
-            {
-                buffer[i] = charRead;
-                charRead = fgetc(stdin);
-                i++;
-            }
-
-            buffer[i + 1] = '\0';
-            Item *item = talloc(sizeof(Item));
-            item->type = SYMBOL_TYPE;
-            item->s = talloc(sizeof(buffer));
-            strcpy(item->s, buffer);
-            list = cons(item, list);
-            continue;
+            skipSymbol();
+            Item *item = internLength(tokenStart, position - tokenStart);
+            return countToken(item);
         }
+    }
+}
 
-        charRead = fgetc(stdin);
+// Takes the input and returns a linkedlist that contains the tokens
+Item *tokenize()
+{
+    Item *list = makeNull();
+    Item *token;
+    while ((token = readToken()) != NULL)
+    {
+        list = cons(token, list);
     }
     Item *revList = reverse(list);
     return revList;
 }
 
+// Returns the number of bytes of input read so far
+size_t tokenizerBytesRead()
+{
+    return bytesRead;
+}
+
+// Returns the number of tokens read so far
+size_t tokenizerTokensRead()
+{
+    return tokensRead;
+}
+
 // Takes an item and prints its content
 void print_token(Item *current)
 {
-    switch (current->type)
+    switch (typeOf(current))
     {
     case INT_TYPE:
-        printf("%d:integer", current->i);
+        printf("%d:integer", intValue(current));
 
         return;
     case DOUBLE_TYPE:
@@ -318,11 +567,11 @@ void print_token(Item *current)
 
         break;
     case STR_TYPE:
-        printf("%s:string", current->s);
+        printf("%.*s:string", current->str.length, current->str.chars);
 
         break;
     case BOOL_TYPE:
-        printf("%s:boolean", current->s);
+        printf("%s:boolean", current == TRUE_ITEM ? "#t" : "#f");
 
         break;
     case SYMBOL_TYPE:
@@ -361,7 +610,7 @@ void displayTokens(Item *list)
     Item *current = list;
     while (!isNull(current))
     {
-        if (current->type == CONS_TYPE)
+        if (typeOf(current) == CONS_TYPE)
         {
             print_token(car(current));
             printf("\n");
@@ -1,12 +1,28 @@
+#include <stddef.h>
 #include "item.h"
 
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
-// Read all of the input from stdin, and return a linked list consisting of the
-// tokens.
+// Takes the path of a source file and makes the tokenizer read it instead of
+// stdin.
+void tokenizerOpen(char *path);
+
+// Read all of the input, from stdin unless tokenizerOpen named a file, and
+// return a linked list consisting of the tokens.
 Item *tokenize();
 
+// Reads the next token from the input and returns it, or NULL at the end of
+// the input. Parentheses and brackets are shared items that are never
+// allocated.
+Item *readToken();
+
+// Returns the number of bytes of input read so far.
+size_t tokenizerBytesRead();
+
+// Returns the number of tokens read so far.
+size_t tokenizerTokensRead();
+
 // Displays the contents of the linked list as tokens, with type information
 void displayTokens(Item *list);
 
@@ -0,0 +1,749 @@
+#include <stdio.h>
+#include <string.h>
+#include "item.h"
+#include "talloc.h"
+#include "gc.h"
+#include "linkedlist.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "compiler.h"
+#include "vm.h"
+
+// Instructions are dispatched by direct threading where the compiler supports
+// taking the address of a label, as GCC and Clang do: each Code is rewritten
+// once so that every opcode is the address of the code that runs it, and each
+// instruction jumps straight to the next one. Building with
+// -DVM_SWITCH_DISPATCH (see the justfile) uses a portable switch instead.
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED
+#endif
+
+#ifdef VM_THREADED
+#define INSTRUCTION(op) op##_LABEL:
+#define NEXT() goto *(void *)ops[ip++]
+#else
+#define INSTRUCTION(op) case op:
+#define NEXT() break
+#endif
+
+// The value stack holds the operands of every instruction. A call keeps its
+// caller's frame in the stack slot the procedure was in, with the code item
+// and instruction to go back to above it. It is a root for the rest of the
+// run, and frames and items can be told apart by their header, so it can hold
+// both; the code item keeps the caller's unit alive while it waits, and
+// instruction indexes are integers, so the collector leaves them alone.
+// Everything a continuation needs is then on this one stack.
+static Item **stack = NULL;
+static size_t stackCount = 0;
+static size_t stackCapacity = 0;
+
+// The number of calls waiting to be returned to, and the most there have been
+static size_t returnCount = 0;
+static size_t peakReturns = 0;
+
+// The stack index each return level's part of the stack starts at, just
+// above the record of the call that made it
+static size_t *starts = NULL;
+static size_t startsCapacity = 0;
+
+// A continuation's record of where to resume, kept in a frame in its saved
+// field: the stack count and return count once its value is in place, the
+// code and instruction to go on with, and the stack below its value, once
+// any of that has had to be copied
+#define RECORD_STACK 0
+#define RECORD_RETURNS 1
+#define RECORD_CODE 2
+#define RECORD_IP 3
+#define RECORD_SAVED 4
+#define RECORD_SIZE 5
+
+// Continuations whose call/cc has not returned, innermost last. While one is
+// here the stack below it is untouched, so it can be resumed without copying
+// anything.
+static Item **openContinuations = NULL;
+static size_t openCount = 0;
+static size_t openCapacity = 0;
+
+// A saved stack is a chain of frames, one per return level, running down
+// through their parents from the continuation's own level, each with the
+// stack index it was copied from in its names. A level is copied only when
+// the VM goes back below it, so until then the chain ends in a hole: an empty
+// frame, with the level in its bindings, standing for the stack below that
+// level. Holes still waiting are kept here, innermost last, and every chain
+// that reaches a level shares its hole, so no level is copied twice.
+static Frame **holes = NULL;
+static size_t holeCount = 0;
+static size_t holeCapacity = 0;
+
+// The return count the VM must get below before anything has to be copied,
+// or 0 if nothing does
+static size_t closeBelow = 0;
+
+// Takes a number of entries and makes sure the value stack can hold that many,
+// growing it out of talloc if needed
+static void reserve(size_t count)
+{
+    if (count > stackCapacity)
+    {
+        // the old stack is simply left behind in the arena
+        size_t grown = stackCapacity == 0 ? 1024 : stackCapacity * 2;
+        while (grown < count)
+        {
+            grown *= 2;
+        }
+        Item **copy = talloc(grown * sizeof(Item *));
+        if (stackCount > 0)
+        {
+            memcpy(copy, stack, stackCount * sizeof(Item *));
+        }
+        stack = copy;
+        stackCapacity = grown;
+    }
+}
+
+// Takes an item or frame pointer and pushes it on the value stack
+static void push(Item *item)
+{
+    if (stackCount == stackCapacity)
+    {
+        reserve(stackCount + 1);
+    }
+    stack[stackCount++] = item;
+}
+
+// Takes the return count of a call being made and records that its level
+// starts at the top of the stack
+static void startLevel(size_t level)
+{
+    if (level >= startsCapacity)
+    {
+        size_t grown = startsCapacity == 0 ? 1024 : startsCapacity * 2;
+        size_t *copy = talloc(grown * sizeof(size_t));
+        if (startsCapacity > 0)
+        {
+            memcpy(copy, starts, startsCapacity * sizeof(size_t));
+        }
+        starts = copy;
+        startsCapacity = grown;
+    }
+    starts[level] = stackCount;
+}
+
+// Takes a return level and returns the hole standing for the stack below it,
+// making one if there is none yet, or NULL at the bottom level
+static Frame *holeBelow(size_t level)
+{
+    if (level == 0)
+    {
+        return NULL;
+    }
+    if (holeCount > 0 && (size_t)intValue(holes[holeCount - 1]->bindings) == level)
+    {
+        return holes[holeCount - 1];
+    }
+    if (holeCount == holeCapacity)
+    {
+        size_t grown = holeCapacity == 0 ? 64 : holeCapacity * 2;
+        Frame **copy = talloc(grown * sizeof(Frame *));
+        if (holeCount > 0)
+        {
+            memcpy(copy, holes, holeCount * sizeof(Frame *));
+        }
+        holes = copy;
+        holeCapacity = grown;
+    }
+    Frame *hole = gcFrame(0);
+    hole->bindings = makeInt(level);
+    holes[holeCount++] = hole;
+    return hole;
+}
+
+// Takes a return level and a stack index above its start, and returns a copy
+// of the stack between them that goes on into the hole below the level
+static Frame *copyLevel(size_t level, size_t end)
+{
+    size_t start = starts[level];
+    Frame *chunk = gcFrame(end - start);
+    chunk->names = makeInt(start);
+    memcpy(chunk->slots, &stack[start], (end - start) * sizeof(Item *));
+    chunk->parent = holeBelow(level);
+    gcWriteBarrier(chunk);
+    return chunk;
+}
+
+// Takes a saved stack and the return level it was saved at, and copies each
+// of its levels back to the stack, which must be able to hold them, as far
+// down as its first hole still waiting
+static void restoreStack(Frame *chain, size_t level)
+{
+    for (; chain != NULL; chain = chain->parent)
+    {
+        if (chain->names != NULL)
+        {
+            size_t start = intValue(chain->names);
+            memcpy(&stack[start], chain->slots, chain->size * sizeof(Item *));
+            starts[level--] = start;
+        }
+    }
+}
+
+// Takes a continuation whose call/cc has not returned and remembers it
+static void openContinuation(Item *continuation)
+{
+    if (openCount == openCapacity)
+    {
+        size_t grown = openCapacity == 0 ? 64 : openCapacity * 2;
+        Item **copy = talloc(grown * sizeof(Item *));
+        if (openCount > 0)
+        {
+            memcpy(copy, openContinuations, openCount * sizeof(Item *));
+        }
+        openContinuations = copy;
+        openCapacity = grown;
+    }
+    openContinuations[openCount++] = continuation;
+    closeBelow = returnCount + 1;
+}
+
+// Returns the return count the VM must get below before the innermost open
+// continuation or hole needs its level copied
+static size_t nextClose()
+{
+    size_t next = 0;
+    if (holeCount > 0)
+    {
+        next = intValue(holes[holeCount - 1]->bindings);
+    }
+    if (openCount > 0)
+    {
+        Frame *record = openContinuations[openCount - 1]->k.saved;
+        size_t open = intValue(record->slots[RECORD_RETURNS]) + 1;
+        next = open > next ? open : next;
+    }
+    return next;
+}
+
+// Takes a return count the VM is about to go back to, and before anything
+// above that level's start can change, copies what is still wanted of it: the
+// top of each open continuation whose call/cc returns by going back there,
+// and the levels waiting holes stand for. Only the levels being left are
+// copied, each at most once.
+static void closeContinuations(size_t level)
+{
+    size_t next;
+    while ((next = nextClose()) > level)
+    {
+        // a hole is filled before a continuation at the same level takes
+        // the hole below it, so the holes stay in order
+        if (holeCount > 0 && (size_t)intValue(holes[holeCount - 1]->bindings) == next)
+        {
+            Frame *hole = holes[--holeCount];
+            hole->parent = copyLevel(next - 1, starts[next]);
+            gcWriteBarrier(hole);
+        }
+        else
+        {
+            Frame *record = openContinuations[--openCount]->k.saved;
+            // the value goes in the top slot, so that is left out
+            record->slots[RECORD_SAVED] = (Item *)copyLevel(next - 1, intValue(record->slots[RECORD_STACK]) - 1);
+            gcWriteBarrier(record);
+        }
+    }
+    closeBelow = next;
+}
+
+#ifdef VM_THREADED
+// The number of operands that follow each instruction
+static const int operandCounts[] = {
+    [OP_IMMEDIATE] = 1,
+    [OP_CONST] = 1,
+    [OP_LOCAL] = 2,
+    [OP_SET_LOCAL] = 2,
+    [OP_GLOBAL] = 1,
+    [OP_SET_GLOBAL] = 1,
+    [OP_NAME] = 1,
+    [OP_SET_NAME] = 1,
+    [OP_DEFINE] = 1,
+    [OP_POP] = 0,
+    [OP_JUMP] = 1,
+    [OP_JUMP_IF_FALSE] = 1,
+    [OP_CLOSURE] = 1,
+    [OP_CALL] = 1,
+    [OP_TAIL_CALL] = 1,
+    [OP_ARITHMETIC] = 2,
+    [OP_RETURN] = 0,
+    [OP_PUSH_FRAME] = 3,
+    [OP_FILL_FRAME] = 1,
+    [OP_POP_FRAME] = 1,
+    [OP_DISPLAY] = 0,
+    [OP_NEWLINE] = 0,
+    [OP_SET_CAR] = 0,
+    [OP_SET_CDR] = 0,
+    [OP_ERROR] = 1,
+};
+
+// Takes a piece of code and the address of the VM code for each opcode, and
+// replaces every opcode in it with its address
+static void thread(Code *code, void *const *labels)
+{
+    int ip = 0;
+    while (ip < code->length)
+    {
+        opcode op = code->ops[ip];
+        code->ops[ip] = (intptr_t)labels[op];
+        ip += 1 + operandCounts[op];
+    }
+    code->threaded = true;
+}
+#endif
+
+// Takes a number of values on top of the stack, pops them and returns them as
+// a list in the order they were pushed
+static Item *popList(int count)
+{
+    Item *list = makeNull();
+    for (int i = 0; i < count; i++)
+    {
+        list = cons(stack[--stackCount], list);
+    }
+    return list;
+}
+
+// Takes a top-level form and the frame to run it in, and returns its value
+Item *vmEval(Item *form, Frame *frame)
+{
+#ifdef VM_THREADED
+    static void *const labels[] = {
+        [OP_IMMEDIATE] = &&OP_IMMEDIATE_LABEL,
+        [OP_CONST] = &&OP_CONST_LABEL,
+        [OP_LOCAL] = &&OP_LOCAL_LABEL,
+        [OP_SET_LOCAL] = &&OP_SET_LOCAL_LABEL,
+        [OP_GLOBAL] = &&OP_GLOBAL_LABEL,
+        [OP_SET_GLOBAL] = &&OP_SET_GLOBAL_LABEL,
+        [OP_NAME] = &&OP_NAME_LABEL,
+        [OP_SET_NAME] = &&OP_SET_NAME_LABEL,
+        [OP_DEFINE] = &&OP_DEFINE_LABEL,
+        [OP_POP] = &&OP_POP_LABEL,
+        [OP_JUMP] = &&OP_JUMP_LABEL,
+        [OP_JUMP_IF_FALSE] = &&OP_JUMP_IF_FALSE_LABEL,
+        [OP_CLOSURE] = &&OP_CLOSURE_LABEL,
+        [OP_CALL] = &&OP_CALL_LABEL,
+        [OP_TAIL_CALL] = &&OP_TAIL_CALL_LABEL,
+        [OP_ARITHMETIC] = &&OP_ARITHMETIC_LABEL,
+        [OP_RETURN] = &&OP_RETURN_LABEL,
+        [OP_PUSH_FRAME] = &&OP_PUSH_FRAME_LABEL,
+        [OP_FILL_FRAME] = &&OP_FILL_FRAME_LABEL,
+        [OP_POP_FRAME] = &&OP_POP_FRAME_LABEL,
+        [OP_DISPLAY] = &&OP_DISPLAY_LABEL,
+        [OP_NEWLINE] = &&OP_NEWLINE_LABEL,
+        [OP_SET_CAR] = &&OP_SET_CAR_LABEL,
+        [OP_SET_CDR] = &&OP_SET_CDR_LABEL,
+        [OP_ERROR] = &&OP_ERROR_LABEL,
+    };
+#endif
+
+    if (stack == NULL)
+    {
+        gcAddRoots((void ***)&stack, &stackCount);
+        gcAddRoots((void ***)&openContinuations, &openCount);
+        gcAddRoots((void ***)&holes, &holeCount);
+    }
+
+    // like eval, the VM collects on the way in, since a form that makes no
+    // calls never reaches a safepoint of its own
+    size_t roots = gcDepth();
+    gcPush(&form);
+    gcPush(&frame);
+    gcSafepoint();
+
+    // the code item of whatever is running keeps its unit alive; the code and
+    // constants are pinned, so they can be held directly
+    Item *current = compile(form);
+    gcPush(&current);
+    Code *code = current->code.address;
+#ifdef VM_THREADED
+    thread(code, labels);
+#endif
+    Item **constants = current->code.unit->slots;
+    intptr_t *ops = code->ops;
+    int ip = 0;
+    // the number of arguments of the call being made, and whether it is in
+    // tail position
+    int count;
+    bool tail;
+
+    size_t base = returnCount;
+    startLevel(base);
+
+#ifdef VM_THREADED
+    NEXT();
+#else
+    while (true)
+    {
+        switch (ops[ip++])
+        {
+#endif
+    INSTRUCTION(OP_IMMEDIATE)
+    {
+        push((Item *)ops[ip++]);
+        NEXT();
+    }
+    INSTRUCTION(OP_CONST)
+    {
+        push(constants[ops[ip++]]);
+        NEXT();
+    }
+    INSTRUCTION(OP_LOCAL)
+    {
+        Frame *owner = frame;
+        for (int depth = ops[ip++]; depth > 0; depth--)
+        {
+            owner = owner->parent;
+        }
+        Item *value = owner->slots[ops[ip++]];
+        if (value == NULL)
+        {
+            evaluationError("variable used before it was assigned");
+        }
+        push(value);
+        NEXT();
+    }
+    INSTRUCTION(OP_SET_LOCAL)
+    {
+        Frame *owner = frame;
+        for (int depth = ops[ip++]; depth > 0; depth--)
+        {
+            owner = owner->parent;
+        }
+        owner->slots[ops[ip++]] = stack[stackCount - 1];
+        gcWriteBarrier(owner);
+        stack[stackCount - 1] = VOID_ITEM;
+        NEXT();
+    }
+    INSTRUCTION(OP_GLOBAL)
+    {
+        push(cdr(getGlobalCell(constants[ops[ip++]])));
+        NEXT();
+    }
+    INSTRUCTION(OP_NAME)
+    {
+        push(getsymbolfromframe(constants[ops[ip++]], frame));
+        NEXT();
+    }
+    INSTRUCTION(OP_SET_GLOBAL)
+    INSTRUCTION(OP_SET_NAME)
+    {
+        setVariable(constants[ops[ip++]], stack[stackCount - 1], frame);
+        stack[stackCount - 1] = VOID_ITEM;
+        NEXT();
+    }
+    INSTRUCTION(OP_DEFINE)
+    {
+        defineVariable(constants[ops[ip++]], stack[stackCount - 1], frame);
+        stack[stackCount - 1] = VOID_ITEM;
+        NEXT();
+    }
+    INSTRUCTION(OP_POP)
+    {
+        stackCount--;
+        NEXT();
+    }
+    INSTRUCTION(OP_JUMP)
+    {
+        ip = ops[ip];
+        NEXT();
+    }
+    INSTRUCTION(OP_JUMP_IF_FALSE)
+    {
+        if (stack[--stackCount] == FALSE_ITEM)
+        {
+            ip = ops[ip];
+        }
+        else
+        {
+            ip++;
+        }
+        NEXT();
+    }
+    INSTRUCTION(OP_CLOSURE)
+    {
+        Item *body = constants[ops[ip++]];
+        Item *closure = gcItem();
+        closure->type = CLOSURE_TYPE;
+        closure->cl.paramNames = constants[((Code *)body->code.address)->names];
+        closure->cl.functionCode = body;
+        closure->cl.frame = frame;
+        push(closure);
+        NEXT();
+    }
+    INSTRUCTION(OP_TAIL_CALL)
+    {
+        tail = true;
+        count = ops[ip++];
+        goto call;
+    }
+    INSTRUCTION(OP_ARITHMETIC)
+    {
+        arithmeticOp op = ops[ip++];
+        tail = ops[ip++];
+        Item *result;
+        if (isArithmeticPrimitive(op, stack[stackCount - 3]) &&
+            fixnumArithmetic(op, stack[stackCount - 2], stack[stackCount - 1], &result))
+        {
+            stackCount -= 2;
+            stack[stackCount - 1] = result;
+            NEXT();
+        }
+        count = 2;
+        goto call;
+    }
+    INSTRUCTION(OP_CALL)
+    {
+        tail = false;
+        count = ops[ip++];
+    call:;
+        gcSafepoint();
+
+    apply:;
+        Item *procedure = stack[stackCount - count - 1];
+        if (typeOf(procedure) == PRIMITIVE_TYPE && procedure->prim.pf == p_callcc)
+        {
+            if (count != 1)
+            {
+                arityError(procedure);
+            }
+            // the value of the call/cc goes where call/cc is now, and nothing
+            // is copied until it has to be
+            Frame *record = gcFrame(RECORD_SIZE);
+            record->slots[RECORD_STACK] = makeInt(stackCount - 1);
+            record->slots[RECORD_RETURNS] = makeInt(returnCount);
+            record->slots[RECORD_CODE] = current;
+            record->slots[RECORD_IP] = makeInt(ip);
+            Item *continuation = gcItem();
+            continuation->type = CONTINUATION_TYPE;
+            continuation->k.frame = frame;
+            continuation->k.saved = record;
+            openContinuation(continuation);
+
+            // then call the procedure with it, never as a tail call, so the
+            // continuation's stack is left as it was until the call returns
+            stack[stackCount - 2] = stack[stackCount - 1];
+            stack[stackCount - 1] = continuation;
+            tail = false;
+            goto apply;
+        }
+        if (typeOf(procedure) == PRIMITIVE_TYPE)
+        {
+            // the arguments are handed over where they are on the stack
+            Item *result = callPrimitive(procedure, count, &stack[stackCount - count]);
+            stackCount -= count;
+            stack[stackCount - 1] = result;
+            NEXT();
+        }
+        if (typeOf(procedure) == CONTINUATION_TYPE)
+        {
+            if (count != 1)
+            {
+                evaluationError("continuation takes exactly one argument");
+            }
+            Item *value = stack[stackCount - 1];
+            Frame *record = procedure->k.saved;
+            size_t target = intValue(record->slots[RECORD_STACK]);
+            size_t level = intValue(record->slots[RECORD_RETURNS]);
+            bool intact = record->slots[RECORD_SAVED] == NULL;
+
+            // everything inside the continuation is left for good; going back
+            // into one that had returned replaces the stack down to where its
+            // saved levels reach one that is still there
+            if (intact)
+            {
+                closeContinuations(level);
+            }
+            else
+            {
+                Frame *saved = (Frame *)record->slots[RECORD_SAVED];
+                size_t kept = 0;
+                for (Frame *chunk = saved; chunk != NULL; chunk = chunk->parent)
+                {
+                    if (chunk->names == NULL && chunk->parent == NULL)
+                    {
+                        kept = intValue(chunk->bindings);
+                    }
+                }
+                closeContinuations(kept);
+                reserve(target);
+                restoreStack(saved, level);
+            }
+            stackCount = target;
+            stack[stackCount - 1] = value;
+            returnCount = level;
+            frame = procedure->k.frame;
+            current = record->slots[RECORD_CODE];
+            code = current->code.address;
+            constants = current->code.unit->slots;
+            ops = code->ops;
+            ip = intValue(record->slots[RECORD_IP]);
+            NEXT();
+        }
+        if (typeOf(procedure) != CLOSURE_TYPE)
+        {
+            evaluationError("not a procedure");
+        }
+
+        Code *body = procedure->cl.functionCode->code.address;
+        Frame *callee;
+        if (body->variadic)
+        {
+            // (lambda args ...) gets all of its arguments as one list
+            Item *args = popList(count);
+            callee = makeFrame(procedure->cl.frame, procedure->cl.paramNames, 1);
+            callee->slots[0] = args;
+        }
+        else
+        {
+            if (count != body->arity)
+            {
+                evaluationError("number of actual parameters does not equal number of formal parameters");
+            }
+            callee = makeFrame(procedure->cl.frame, procedure->cl.paramNames, count);
+            stackCount -= count;
+            memcpy(callee->slots, &stack[stackCount], count * sizeof(Item *));
+        }
+
+        if (tail)
+        {
+            // nothing is left to do here, so the callee returns straight to
+            // this procedure's caller, whose frame is already on the stack
+            stackCount--;
+        }
+        else
+        {
+            // the caller's frame takes the procedure's place on the stack
+            stack[stackCount - 1] = (Item *)frame;
+            push(current);
+            push(makeInt(ip));
+            returnCount++;
+            startLevel(returnCount);
+            if (returnCount > peakReturns)
+            {
+                peakReturns = returnCount;
+            }
+        }
+        frame = callee;
+        current = procedure->cl.functionCode;
+        code = body;
+        constants = current->code.unit->slots;
+#ifdef VM_THREADED
+        if (!code->threaded)
+        {
+            thread(code, labels);
+        }
+#endif
+        ops = code->ops;
+        ip = 0;
+        NEXT();
+    }
+    INSTRUCTION(OP_RETURN)
+    {
+        Item *result = stack[--stackCount];
+        if (returnCount == base)
+        {
+            gcPop(roots);
+            return result;
+        }
+        returnCount--;
+        if (returnCount < closeBelow)
+        {
+            closeContinuations(returnCount);
+        }
+        ip = intValue(stack[--stackCount]);
+        current = stack[--stackCount];
+        code = current->code.address;
+        constants = current->code.unit->slots;
+        ops = code->ops;
+        frame = (Frame *)stack[stackCount - 1];
+        stack[stackCount - 1] = result;
+        NEXT();
+    }
+    INSTRUCTION(OP_PUSH_FRAME)
+    {
+        int size = ops[ip++];
+        int filled = ops[ip++];
+        Frame *inner = makeFrame(frame, constants[ops[ip++]], size);
+        stackCount -= filled;
+        memcpy(inner->slots, &stack[stackCount], filled * sizeof(Item *));
+        frame = inner;
+        NEXT();
+    }
+    INSTRUCTION(OP_FILL_FRAME)
+    {
+        int count = ops[ip++];
+        stackCount -= count;
+        memcpy(frame->slots, &stack[stackCount], count * sizeof(Item *));
+        gcWriteBarrier(frame);
+        NEXT();
+    }
+    INSTRUCTION(OP_POP_FRAME)
+    {
+        for (int count = ops[ip++]; count > 0; count--)
+        {
+            frame = frame->parent;
+        }
+        NEXT();
+    }
+    INSTRUCTION(OP_DISPLAY)
+    {
+        printTree(stack[stackCount - 1]);
+        stack[stackCount - 1] = VOID_ITEM;
+        NEXT();
+    }
+    INSTRUCTION(OP_NEWLINE)
+    {
+        printf("\n");
+        push(VOID_ITEM);
+        NEXT();
+    }
+    INSTRUCTION(OP_SET_CAR)
+    {
+        Item *value = stack[--stackCount];
+        Item *pair = stack[stackCount - 1];
+        if (typeOf(pair) != CONS_TYPE)
+        {
+            evaluationError("not cons type");
+        }
+        pair->c.car = value;
+        gcWriteBarrier(pair);
+        stack[stackCount - 1] = VOID_ITEM;
+        NEXT();
+    }
+    INSTRUCTION(OP_SET_CDR)
+    {
+        Item *value = stack[--stackCount];
+        Item *pair = stack[stackCount - 1];
+        if (typeOf(pair) != CONS_TYPE)
+        {
+            evaluationError("not cons type");
+        }
+        pair->c.cdr = value;
+        gcWriteBarrier(pair);
+        stack[stackCount - 1] = VOID_ITEM;
+        NEXT();
+    }
+    INSTRUCTION(OP_ERROR)
+    {
+        evaluationError((char *)ops[ip]);
+        NEXT();
+    }
+#ifndef VM_THREADED
+        }
+    }
+#endif
+}
+
+// Prints the most calls that were ever waiting to return and the size the
+// value stack grew to, to stderr.
+void vmPrintStats()
+{
+    fprintf(stderr, "vm peak call depth:   %zu\n", peakReturns);
+    fprintf(stderr, "vm value stack size:  %zu slots\n", stackCapacity);
+}
@@ -0,0 +1,15 @@
+#include "item.h"
+
+#ifndef VM_H
+#define VM_H
+
+// Takes a top-level form that has been through resolve() and the frame to
+// run it in, compiles it to bytecode and runs it on the stack machine.
+// Returns the value of the form, as eval would.
+Item *vmEval(Item *form, Frame *frame);
+
+// Prints the most calls that were ever waiting to return and the size the
+// value stack grew to, to stderr.
+void vmPrintStats();
+
+#endif